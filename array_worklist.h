@@ -0,0 +1,419 @@
+#pragma once
+#include <algorithm>
+#include <emu_cxx_utils/replicated.h>
+#include <emu_cxx_utils/repl_array.h>
+#include <emu_cxx_utils/intrinsics.h>
+#include <emu_cxx_utils/execution_policy.h>
+#include <cilk/cilk.h>
+
+/**
+ * Work list of edge ranges, stored as a contiguous array on each nodelet.
+ *
+ * Same interface as worklist, but instead of a linked list threaded through
+ * per-vertex arrays, each nodelet stores a dense array of (src, begin, end)
+ * items. Before processing, each nodelet computes a prefix sum of the edge
+ * counts so that workers can claim edge-balanced chunks with a single atomic
+ * on a shared edge index, and then binary search to find the first item.
+ * Workers never walk items that have already been claimed, and a vertex with
+ * many edges can be split across several workers.
+ *
+ * Each vertex can be appended at most once between calls to clear().
+ * Optionally, vertices above a degree threshold are split into several items
+ * and spread across nodelets, as in worklist.
+ */
+template<class Edge>
+class array_worklist {
+private:
+    // Number of items in the local array
+    long size_;
+    // Total number of edges in the local array (valid after compute_offsets)
+    long num_edges_;
+    // Index of the next edge to be claimed by a worker
+    long next_edge_;
+    // Vertices with more than this many edges are split into several
+    // items when appended. Zero disables splitting.
+    long split_threshold_;
+
+    // Storage for items on each nodelet
+    emu::repl_array<long> src_;
+    emu::repl_array<Edge*> begin_;
+    emu::repl_array<Edge*> end_;
+    // Prefix sum of the number of edges in each item (one extra at the end)
+    emu::repl_array<long> offsets_;
+
+    // Pointers to the copy of each array that is local to this nodelet
+    long * src_ptr_;
+    Edge ** begin_ptr_;
+    Edge ** end_ptr_;
+    long * offsets_ptr_;
+
+    // Max number of items on each nodelet. Split items are dealt out
+    // round-robin, and a vertex with d edges yields at most 2d/threshold.
+    static long
+    capacity(long num_vertices, long num_edges, long split_threshold)
+    {
+        long n = (num_vertices + NODELETS() - 1) / NODELETS();
+        if (split_threshold > 0) { n += 2 * num_edges / split_threshold; }
+        return n;
+    }
+
+public:
+    explicit array_worklist(long num_vertices)
+    : array_worklist(num_vertices, 0, 0)
+    {}
+
+    /**
+     * Constructs a work list that splits high-degree vertices.
+     * @param num_vertices Number of vertices in the graph
+     * @param num_edges Max number of edges appended between calls to clear()
+     * @param split_threshold Vertices with more edges than this are split
+     * into several items of split_threshold edges, spread across nodelets.
+     */
+    array_worklist(long num_vertices, long num_edges, long split_threshold)
+    : size_(0)
+    , num_edges_(0)
+    , next_edge_(0)
+    , split_threshold_(split_threshold)
+    , src_(capacity(num_vertices, num_edges, split_threshold))
+    , begin_(capacity(num_vertices, num_edges, split_threshold))
+    , end_(capacity(num_vertices, num_edges, split_threshold))
+    , offsets_(capacity(num_vertices, num_edges, split_threshold) + 1)
+    , src_ptr_(src_.get_localto(this))
+    , begin_ptr_(begin_.get_localto(this))
+    , end_ptr_(end_.get_localto(this))
+    , offsets_ptr_(offsets_.get_localto(this))
+    {}
+
+    // Shallow copy constructor
+    array_worklist(const array_worklist& other, emu::shallow_copy shallow)
+    : size_(0)
+    , num_edges_(0)
+    , next_edge_(0)
+    , split_threshold_(other.split_threshold_)
+    , src_(other.src_, shallow)
+    , begin_(other.begin_, shallow)
+    , end_(other.end_, shallow)
+    , offsets_(other.offsets_, shallow)
+    , src_ptr_(src_.get_localto(this))
+    , begin_ptr_(begin_.get_localto(this))
+    , end_ptr_(end_.get_localto(this))
+    , offsets_ptr_(offsets_.get_localto(this))
+    {}
+
+    /**
+     * Reset all replicated copies of the work list.
+     * Only valid to call on replicated instance
+     */
+    void clear_all()
+    {
+        assert(emu::pmanip::is_repl(this));
+        for (long nlet = 0; nlet < NODELETS(); ++nlet) {
+            get_nth(nlet).clear();
+        }
+    }
+
+    /**
+     * Reset the work list so that new edges can be added
+     */
+    void clear()
+    {
+        size_ = 0;
+    }
+
+    /**
+     * Returns the nth replicated copy of the work list
+     * Only valid to call on a replicated instance
+     * @param n nodelet ID
+     * @return the nth replicated copy of the work list
+     */
+    array_worklist&
+    get_nth(long n)
+    {
+        return *emu::pmanip::get_nth(this, n);
+    }
+
+    /**
+     * Atomically append edges to the work list.
+     *
+     * @param src source vertex for all edges
+     * @param edges_begin Pointer to start of edge list to append
+     * @param edges_end Pointer past the end of the edge list to append
+     */
+    void append(long src, Edge * edges_begin, Edge * edges_end)
+    {
+        assert(emu::pmanip::is_repl(this));
+        if (should_split(edges_begin, edges_end)) {
+            append_split(src, edges_begin, edges_end);
+            return;
+        }
+        push(src & (NODELETS()-1), src, edges_begin, edges_end);
+    }
+
+    /**
+     * Buffers a few items privately, then reserves space for all of them in
+     * the local array with a single atomic.
+     *
+     * Like worklist::appender, this is meant to be captured by value in a
+     * mutable lambda. The buffer is flushed when it fills up, when a vertex
+     * from another nodelet is appended, and when the appender goes out of
+     * scope. High-degree vertices bypass the buffer and are split
+     * immediately.
+     */
+    class appender
+    {
+    private:
+        static constexpr long buffer_size = 8;
+        array_worklist * w_;
+        long nlet_;
+        long count_;
+        long src_[buffer_size];
+        Edge * begin_[buffer_size];
+        Edge * end_[buffer_size];
+    public:
+        explicit appender(array_worklist * w)
+        : w_(w), nlet_(-1), count_(0) {}
+
+        // Copy constructor: refer to the same work list, but start empty
+        appender(const appender& other) : appender(other.w_) {}
+
+        // Destructor: copy buffered items to the work list
+        ~appender() { flush(); }
+
+        void operator()(long src, Edge * edges_begin, Edge * edges_end)
+        {
+            if (w_->should_split(edges_begin, edges_end)) {
+                w_->append_split(src, edges_begin, edges_end);
+                return;
+            }
+            long nlet = src & (NODELETS()-1);
+            if (nlet != nlet_ || count_ == buffer_size) {
+                flush();
+                nlet_ = nlet;
+            }
+            src_[count_] = src;
+            begin_[count_] = edges_begin;
+            end_[count_] = edges_end;
+            count_ += 1;
+        }
+
+        void flush()
+        {
+            if (count_ == 0) { return; }
+            array_worklist& w = w_->get_nth(nlet_);
+            long pos = emu::atomic_addms(&w.size_, count_);
+            for (long i = 0; i < count_; ++i) {
+                w.src_ptr_[pos + i] = src_[i];
+                w.begin_ptr_[pos + i] = begin_[i];
+                w.end_ptr_[pos + i] = end_[i];
+            }
+            count_ = 0;
+        }
+    };
+
+    /**
+     * Returns an appender that can be used to add edges to this work list
+     * without doing an atomic for every item.
+     * Only valid to call on a replicated instance
+     */
+    appender
+    make_appender()
+    {
+        assert(emu::pmanip::is_repl(this));
+        return appender(this);
+    }
+
+    // Number of items in the local array
+    long size() const { return size_; }
+
+private:
+    bool should_split(Edge * edges_begin, Edge * edges_end) const
+    {
+        return split_threshold_ > 0
+            && edges_end - edges_begin > split_threshold_;
+    }
+
+    // Atomically add one item to the array on the specified nodelet
+    void push(long nlet, long src, Edge * edges_begin, Edge * edges_end)
+    {
+        array_worklist& w = get_nth(nlet);
+        long pos = emu::atomic_addms(&w.size_, 1);
+        assert(pos < w.src_.size());
+        w.src_ptr_[pos] = src;
+        w.begin_ptr_[pos] = edges_begin;
+        w.end_ptr_[pos] = edges_end;
+    }
+
+    // Break the edge list of src into items of split_threshold_ edges, and
+    // deal them out to each nodelet, starting with the one where src lives
+    void append_split(long src, Edge * edges_begin, Edge * edges_end)
+    {
+        long nlet = src & (NODELETS()-1);
+        for (Edge * e1 = edges_begin; e1 < edges_end; e1 += split_threshold_) {
+            Edge * e2 = e1 + split_threshold_;
+            if (e2 > edges_end) { e2 = edges_end; }
+            push(nlet, src, e1, e2);
+            nlet = (nlet + 1) & (NODELETS()-1);
+        }
+    }
+
+    // Sum up the edge counts for items in [begin, end)
+    long
+    count_edges(long begin, long end)
+    {
+        long sum = 0;
+        for (long i = begin; i < end; ++i) {
+            sum += end_ptr_[i] - begin_ptr_[i];
+        }
+        return sum;
+    }
+
+    // Write offsets for items in [begin, end), starting at the given offset
+    void
+    write_offsets(long begin, long end, long offset)
+    {
+        for (long i = begin; i < end; ++i) {
+            offsets_ptr_[i] = offset;
+            offset += end_ptr_[i] - begin_ptr_[i];
+        }
+    }
+
+    /**
+     * Computes the exclusive prefix sum of edge counts for the local array,
+     * and resets the shared edge index.
+     * Two passes: each thread sums a contiguous chunk, then each thread
+     * writes offsets for its chunk starting from the sum of previous chunks.
+     */
+    void
+    compute_offsets()
+    {
+        const long num_chunks = emu::threads_per_nodelet;
+        const long chunk_size = (size_ + num_chunks - 1) / num_chunks;
+        long partial_sums[num_chunks];
+        for (long c = 0; c < num_chunks; ++c) {
+            long begin = std::min(c * chunk_size, size_);
+            long end = std::min(begin + chunk_size, size_);
+            partial_sums[c] = cilk_spawn count_edges(begin, end);
+        }
+        cilk_sync;
+        long offset = 0;
+        for (long c = 0; c < num_chunks; ++c) {
+            long begin = std::min(c * chunk_size, size_);
+            long end = std::min(begin + chunk_size, size_);
+            cilk_spawn write_offsets(begin, end, offset);
+            offset += partial_sums[c];
+        }
+        cilk_sync;
+        offsets_ptr_[size_] = offset;
+        num_edges_ = offset;
+        next_edge_ = 0;
+    }
+
+    // Call the visitor on each item that overlaps edges [first, last)
+    template<class Visitor>
+    void
+    visit_edges(long first, long last, Visitor& visitor)
+    {
+        // Find the last item that starts at or before the first edge
+        long i = std::upper_bound(offsets_ptr_, offsets_ptr_ + size_, first)
+            - offsets_ptr_ - 1;
+        while (first < last) {
+            long item_end = offsets_ptr_[i + 1];
+            long stop = std::min(last, item_end);
+            // Skip over items with no edges
+            if (stop > first) {
+                Edge * e1 = begin_ptr_[i] + (first - offsets_ptr_[i]);
+                visitor(src_ptr_[i], e1, e1 + (stop - first));
+                first = stop;
+            }
+            ++i;
+        }
+    }
+
+    // Worker function spawned in dynamic process
+    template<class Visitor, long Grain>
+    void worker(Visitor visitor)
+    {
+        long grain = Grain;
+        // Atomically grab a chunk of edges from the local array
+        for (long e1 = emu::atomic_addms(&next_edge_, grain);
+             e1 < num_edges_;
+             e1 = emu::atomic_addms(&next_edge_, grain))
+        {
+            long e2 = e1 + grain; if (e2 > num_edges_) { e2 = num_edges_; }
+            visit_edges(e1, e2, visitor);
+        }
+    }
+
+public:
+    /**
+     * Process the edges in the work list in parallel
+     * Spawns local worker threads to claim chunks of edges from the array.
+     * @param policy Dynamic policy: grain size indicates how many edges each
+     * thread will claim at a time.
+     * @param visitor Lambda function to call on each range of edges, with
+     * signature: @c void (long src, Edge * begin, Edge * end)
+     */
+    template<class Visitor, long Grain>
+    void process(emu::dynamic_policy<Grain> policy, Visitor visitor)
+    {
+        compute_offsets();
+        for (long t = 0; t < emu::threads_per_nodelet; ++t) {
+            cilk_spawn worker<Visitor, Grain>(visitor);
+        }
+    }
+
+    template<class Visitor, long Grain>
+    void process(emu::parallel_policy<Grain> policy, Visitor visitor)
+    {
+        constexpr long grain = Grain;
+        compute_offsets();
+        // Spawn a thread for each chunk of edges
+        for (long e1 = 0; e1 < num_edges_; e1 += grain) {
+            long e2 = e1 + grain; if (e2 > num_edges_) { e2 = num_edges_; }
+            cilk_spawn visit_edges(e1, e2, visitor);
+        }
+    }
+
+    /**
+     * Process the edges in the work list
+     * @param visitor Lambda function to call on each range of edges, with
+     * signature: @c void (long src, Edge * begin, Edge * end)
+     */
+    template<class Visitor>
+    void process(emu::sequenced_policy, Visitor visitor)
+    {
+        for (long i = 0; i < size_; ++i) {
+            visitor(src_ptr_[i], begin_ptr_[i], end_ptr_[i]);
+        }
+    }
+
+    /**
+     * Process the edges in all replicated copies of the work list
+     * Only valid to call on a replicated instance
+     * @param policy Execution policy to use at each nodelet
+     * @param visitor Lambda function to call on each range of edges, with
+     * signature: @c void (long src, Edge * begin, Edge * end)
+     */
+    template<class Policy, class Visitor>
+    void process_all_ranges(Policy policy, Visitor visitor)
+    {
+        assert(emu::pmanip::is_repl(this));
+        emu::repl_for_each(emu::parallel_policy<1>(), *this,
+            [policy, visitor](array_worklist & w) {
+                w.process(policy, visitor);
+            }
+        );
+    }
+
+    template<class Policy, class Visitor>
+    void process_all_edges(Policy policy, Visitor visitor)
+    {
+        process_all_ranges(policy,
+            [visitor](long src, Edge * begin, Edge * end) mutable {
+                for (auto e = begin; e != end; ++e) {
+                    visitor(src, *e);
+                }
+            }
+        );
+    }
+};
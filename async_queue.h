@@ -0,0 +1,211 @@
+#pragma once
+
+#include <cassert>
+#include <algorithm>
+#include <emu_cxx_utils/replicated.h>
+#include <emu_cxx_utils/repl_array.h>
+#include <emu_cxx_utils/striped_array.h>
+#include <emu_cxx_utils/fill.h>
+#include <emu_cxx_utils/intrinsics.h>
+#include <emu_cxx_utils/pointer_manipulation.h>
+
+/**
+ * Work queue for asynchronous (label-correcting) traversals.
+ *
+ * Each nodelet has a ring buffer of vertices that live on that nodelet. Unlike
+ * chunked_queue there are no windows: items can be popped as soon as they are
+ * pushed, and a vertex can be pushed again after it has been popped.
+ *
+ * Each vertex has a flag that is set while it is in the queue, so a vertex is
+ * never queued twice at the same time. A nodelet never holds more items than
+ * it has vertices, so each ring only needs room for its share of the vertices.
+ *
+ * Each nodelet counts the items pushed to its ring (the tail position) and
+ * the items from its ring that have been marked done. An item is only marked
+ * done after it has pushed all of its successors, so once the pushes and
+ * dones add up to the same total there is no work left anywhere. A worker
+ * only looks at the other nodelets after its own nodelet has drained, and
+ * only one worker per nodelet does so at a time.
+ */
+class async_queue
+{
+private:
+    // Number of slots in the ring on each nodelet
+    long capacity_;
+    // Ring on each nodelet. Empty slots hold -1.
+    emu::repl_array<long> slots_;
+    // Pointer to the ring that is local to this nodelet
+    long * slots_ptr_;
+    // For each vertex, 1 if it is currently in the queue
+    emu::striped_array<long> queued_;
+    // Positions of the next item to pop/push in the local ring. The tail is
+    // also the number of items pushed to this nodelet since the reset.
+    long head_;
+    long tail_;
+    // Number of items from the local ring that have been marked done
+    long done_;
+    // 1 while a worker on this nodelet is checking the other nodelets
+    long checking_;
+    // Set on every nodelet once all the work is done
+    long finished_;
+
+    long &
+    slot(long pos)
+    {
+        return slots_ptr_[pos % capacity_];
+    }
+
+    static long
+    read(long & x)
+    {
+        return *(volatile long *)&x;
+    }
+
+    /**
+     * Returns true if every item that was pushed anywhere has been marked
+     * done. Reads all the done counts before any of the push counts. Both
+     * only go up, so if they match there was a moment in between with no
+     * items pending, and after that no one can push any more.
+     * Only valid to call on a replicated instance
+     */
+    bool
+    all_idle()
+    {
+        long done = 0;
+        for (long n = 0; n < NODELETS(); ++n) {
+            done += read(emu::pmanip::get_nth(this, n)->done_);
+        }
+        long pushed = 0;
+        for (long n = 0; n < NODELETS(); ++n) {
+            pushed += read(emu::pmanip::get_nth(this, n)->tail_);
+        }
+        return pushed == done;
+    }
+
+public:
+    /**
+     * @param num_vertices Number of vertices in the graph
+     */
+    explicit async_queue(long num_vertices)
+    : capacity_((num_vertices + NODELETS() - 1) / NODELETS())
+    , slots_(capacity_ > 0 ? capacity_ : 1)
+    , slots_ptr_(slots_.get_localto(this))
+    , queued_(num_vertices)
+    , head_(0)
+    , tail_(0)
+    , done_(0)
+    , checking_(0)
+    , finished_(0)
+    {
+        for (long n = 0; n < NODELETS(); ++n) {
+            long * ring = slots_.get_nth(n);
+            std::fill(ring, ring + slots_.size(), -1L);
+        }
+        emu::parallel::fill(queued_.begin(), queued_.end(), 0L);
+    }
+
+    // Shallow copy constructor
+    async_queue(const async_queue& other, emu::shallow_copy shallow)
+    : capacity_(other.capacity_)
+    , slots_(other.slots_, shallow)
+    , slots_ptr_(slots_.get_localto(this))
+    , queued_(other.queued_, shallow)
+    , head_(0)
+    , tail_(0)
+    , done_(0)
+    , checking_(0)
+    , finished_(0)
+    {}
+
+    // Reset the positions on each nodelet. The queue must be empty.
+    void
+    reset_all()
+    {
+        emu::repl_for_each(emu::parallel_policy<8>(), *this,
+            [](async_queue& self) {
+                self.head_ = 0;
+                self.tail_ = 0;
+                self.done_ = 0;
+                self.checking_ = 0;
+                self.finished_ = 0;
+            });
+    }
+
+    /**
+     * Add v to the ring on its own nodelet, unless it is already queued.
+     * Call this from the nodelet where v lives, all accesses are then local.
+     * Returns true if v was added.
+     * Only valid to call on a replicated instance
+     */
+    bool
+    push(long v)
+    {
+        if (emu::atomic_cas(&queued_[v], 0L, 1L) != 0) { return false; }
+        async_queue & q = *emu::pmanip::get_nth(this, v & (NODELETS() - 1));
+        // This also counts the push. It must land before the caller is
+        // marked done, so wait for the result.
+        long pos = emu::atomic_addms(&q.tail_, 1);
+        volatile long & s = q.slot(pos);
+        // The slot may still be held by a thread that has not finished
+        // popping the item from the previous trip around the ring
+        while (s != -1) {}
+        s = v;
+        return true;
+    }
+
+    /**
+     * Take an item from the ring on this nodelet.
+     * Returns false if the ring is empty.
+     * Only valid to call on a replicated instance
+     */
+    bool
+    pop(long & v)
+    {
+        long pos = head_;
+        for (;;) {
+            if (pos >= tail_) { return false; }
+            long prev = emu::atomic_cas(&head_, pos, pos + 1);
+            if (prev == pos) { break; }
+            pos = prev;
+        }
+        volatile long & s = slot(pos);
+        // Wait for the pushing thread to fill in the slot
+        while ((v = s) == -1) {}
+        s = -1;
+        // From here on, v can be queued again
+        queued_[v] = 0;
+        return true;
+    }
+
+    // Mark an item returned by pop on this nodelet as finished
+    void
+    done()
+    {
+        emu::remote_add(&done_, 1);
+    }
+
+    /**
+     * Returns true when every item that was pushed has been marked done.
+     * Call this from a worker that found the local ring empty.
+     * Only valid to call on a replicated instance
+     */
+    bool
+    is_finished()
+    {
+        if (read(finished_)) { return true; }
+        // Work is still pending on this nodelet
+        if (read(done_) != read(tail_)) { return false; }
+        // Let one worker per nodelet check the others
+        if (read(checking_) || emu::atomic_cas(&checking_, 0L, 1L) != 0) {
+            return false;
+        }
+        bool idle = all_idle();
+        if (idle) {
+            for (long n = 0; n < NODELETS(); ++n) {
+                emu::pmanip::get_nth(this, n)->finished_ = 1;
+            }
+        }
+        checking_ = 0;
+        return idle;
+    }
+};
@@ -0,0 +1,284 @@
+#include "betweenness.h"
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+#include <queue>
+#include <emu_cxx_utils/execution_policy.h>
+#include <emu_cxx_utils/for_each.h>
+#include <emu_cxx_utils/fill.h>
+#include <emu_cxx_utils/reducers.h>
+
+using namespace emu;
+using namespace emu::parallel;
+
+betweenness::betweenness(graph & g)
+: g_(&g)
+, depth_(g.num_vertices())
+, sigma_(g.num_vertices())
+, delta_(g.num_vertices())
+, scores_(g.num_vertices())
+, queue_(g.num_vertices())
+, num_edges_(0L)
+// Split vertices with more than 4K edges across nodelets
+, worklist_(g.num_vertices(), g.num_edges() * 2, 4096)
+{
+    clear();
+}
+
+// Shallow copy constructor
+betweenness::betweenness(const betweenness& other, emu::shallow_copy shallow)
+: g_(other.g_)
+, depth_(other.depth_, shallow)
+, sigma_(other.sigma_, shallow)
+, delta_(other.delta_, shallow)
+, scores_(other.scores_, shallow)
+, queue_(other.queue_, shallow)
+, num_edges_(other.num_edges_)
+, worklist_(other.worklist_, shallow)
+{}
+
+void
+betweenness::clear()
+{
+    g_->for_each_vertex(fixed, [this](long v) {
+        depth_[v] = -1;
+        sigma_[v] = 0;
+        delta_[v] = 0;
+        scores_[v] = 0;
+    });
+    queue_.reset_all();
+    sources_.clear();
+}
+
+// Remember the window of each nodelet's queue for the current level
+void
+betweenness::save_level()
+{
+    for (long n = 0; n < NODELETS(); ++n) {
+        chunked_queue & q = queue_.get_nth(n);
+        level_bounds_.push_back(q.window_start());
+        level_bounds_.push_back(q.window_end());
+    }
+}
+
+// Point the window of each nodelet's queue back at an earlier level
+void
+betweenness::restore_level(long level)
+{
+    const long * bounds = &level_bounds_[level * NODELETS() * 2];
+    for (long n = 0; n < NODELETS(); ++n) {
+        queue_.get_nth(n).set_window(bounds[2 * n], bounds[2 * n + 1]);
+    }
+}
+
+/**
+ * Top-down BFS step: push every unvisited neighbor of the current level
+ * (at the given depth) to the queue
+ */
+void
+betweenness::discover(long level)
+{
+    worklist_.clear_all();
+    queue_.forall_items(
+        [this, append=worklist_.make_appender()](long src) mutable {
+        remote_add(&num_edges_, g_->out_degree(src));
+        append(src, g_->out_edges_begin(src), g_->out_edges_end(src));
+    });
+    worklist_.process_all_edges(dynamic_unroll_policy<64>(),
+        [this, level, push=queue_.make_pusher()](long src, long dst) mutable {
+            long * depth = &depth_[dst];
+            if (*depth < 0 && atomic_cas(depth, -1L, level + 1) == -1) {
+                push(dst);
+            }
+        }
+    );
+}
+
+/**
+ * Count the shortest paths to each vertex in the current level, by summing
+ * the counts of its neighbors in the level before
+ */
+void
+betweenness::count_paths(long level)
+{
+    worklist_.clear_all();
+    queue_.forall_items(
+        [this, append=worklist_.make_appender()](long v) mutable {
+        append(v, g_->out_edges_begin(v), g_->out_edges_end(v));
+    });
+    worklist_.process_all_ranges(stealing_policy<256>(),
+        [depth=depth_.data(), sigma=sigma_.data(), level]
+        (long src, graph::edge_iterator e1, graph::edge_iterator e2) {
+            reducer_opadd<double> accum(&sigma[src]);
+            for_each(unroll, e1, e2,
+                // Note: capture accum by value, use mutable lambda
+                [accum, depth, sigma, level] (long dst) mutable {
+                    if (depth[dst] == level - 1) { accum += sigma[dst]; }
+                }
+            );
+        }
+    );
+}
+
+/**
+ * Compute the dependency of the source on each vertex in the current level
+ * from the level after it, then add it to the scores
+ */
+void
+betweenness::accumulate(long level)
+{
+    worklist_.clear_all();
+    queue_.forall_items(
+        [this, append=worklist_.make_appender()](long v) mutable {
+        append(v, g_->out_edges_begin(v), g_->out_edges_end(v));
+    });
+    worklist_.process_all_ranges(stealing_policy<256>(),
+        [depth=depth_.data(), sigma=sigma_.data(), delta=delta_.data(), level]
+        (long src, graph::edge_iterator e1, graph::edge_iterator e2) {
+            reducer_opadd<double> accum(&delta[src]);
+            double sigma_src = sigma[src];
+            for_each(unroll, e1, e2,
+                [accum, depth, sigma, delta, sigma_src, level]
+                (long dst) mutable {
+                    if (depth[dst] == level + 1) {
+                        double d = sigma_src / sigma[dst] * (1 + delta[dst]);
+                        accum += d;
+                    }
+                }
+            );
+        }
+    );
+    // Each vertex is in the queue once, so no atomics are needed here
+    queue_.forall_items([this](long v) { scores_[v] += delta_[v]; });
+}
+
+/**
+ * Add the dependencies of the source on every vertex to the scores
+ * Returns the number of edges traversed
+ */
+long
+betweenness::add_source(long source)
+{
+    // Reset the vertices reached from the previous source
+    queue_.forall_pushed([this](long v) {
+        depth_[v] = -1;
+        sigma_[v] = 0;
+        delta_[v] = 0;
+    });
+    queue_.reset_all();
+    level_bounds_.clear();
+    num_edges_ = 0;
+
+    // Forward pass: BFS from the source, counting shortest paths
+    depth_[source] = 0;
+    sigma_[source] = 1;
+    queue_.push_back(source);
+    queue_.slide_all_windows();
+    long num_levels = 0;
+    while (!queue_.all_empty()) {
+        save_level();
+        discover(num_levels++);
+        queue_.slide_all_windows();
+        count_paths(num_levels);
+    }
+
+    // Backward pass: accumulate dependencies, from the deepest level up.
+    // The last level has no dependents, and the source gets no credit.
+    for (long level = num_levels - 2; level > 0; --level) {
+        restore_level(level);
+        accumulate(level);
+    }
+    return repl_reduce(num_edges_, std::plus<>()) / 2;
+}
+
+long
+betweenness::run(const std::vector<long> & sources)
+{
+    assert(!sources.empty());
+    sources_ = sources;
+    long num_edges_traversed = 0;
+    for (long s : sources) {
+        assert(s < g_->num_vertices());
+        num_edges_traversed += add_source(s);
+    }
+    // Extrapolate from the sample
+    double scale = (double)g_->num_vertices() / sources.size();
+    if (scale != 1) {
+        g_->for_each_vertex(fixed, [this, scale](long v) {
+            scores_[v] *= scale;
+        });
+    }
+    return num_edges_traversed;
+}
+
+bool
+betweenness::check()
+{
+    // Serial Brandes from the same sources
+    long n = g_->num_vertices();
+    std::vector<double> expected(n, 0);
+    std::vector<long> depth(n);
+    std::vector<double> sigma(n);
+    std::vector<double> delta(n);
+    std::vector<long> order;
+    for (long s : sources_) {
+        std::fill(depth.begin(), depth.end(), -1);
+        std::fill(sigma.begin(), sigma.end(), 0);
+        std::fill(delta.begin(), delta.end(), 0);
+        order.clear();
+        std::queue<long> q;
+        q.push(s);
+        depth[s] = 0;
+        sigma[s] = 1;
+        while (!q.empty()) {
+            long u = q.front(); q.pop();
+            order.push_back(u);
+            auto edges_begin = g_->out_neighbors(u);
+            auto edges_end = edges_begin + g_->out_degree(u);
+            for (auto e = edges_begin; e < edges_end; ++e) {
+                long v = *e;
+                if (depth[v] < 0) {
+                    depth[v] = depth[u] + 1;
+                    q.push(v);
+                }
+                if (depth[v] == depth[u] + 1) {
+                    sigma[v] += sigma[u];
+                }
+            }
+        }
+        // Visit vertices in reverse BFS order
+        for (auto w = order.rbegin(); w != order.rend(); ++w) {
+            long u = *w;
+            auto edges_begin = g_->out_neighbors(u);
+            auto edges_end = edges_begin + g_->out_degree(u);
+            for (auto e = edges_begin; e < edges_end; ++e) {
+                long v = *e;
+                if (depth[v] == depth[u] + 1) {
+                    delta[u] += sigma[u] / sigma[v] * (1 + delta[v]);
+                }
+            }
+            if (u != s) { expected[u] += delta[u]; }
+        }
+    }
+    double scale = (double)n / sources_.size();
+
+    for (long v = 0; v < n; ++v) {
+        double want = expected[v] * scale;
+        double got = scores_[v];
+        // Sums are done in a different order, allow for rounding
+        if (std::fabs(got - want) > 1e-6 * std::max(1.0, std::fabs(want))) {
+            LOG("Wrong score for vertex %li: %f (expected %f)\n", v, got, want);
+            return false;
+        }
+    }
+    return true;
+}
+
+void
+betweenness::dump()
+{
+    for (long v = 0; v < g_->num_vertices(); ++v) {
+        printf("%li %f\n", v, scores_[v]);
+    }
+    fflush(stdout);
+}
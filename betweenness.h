@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+#include <emu_cxx_utils/replicated.h>
+#include <emu_cxx_utils/striped_array.h>
+#include "common.h"
+#include "graph.h"
+#include "chunked_queue.h"
+#include "worklist.h"
+
+/**
+ * Betweenness centrality (Brandes, "A faster algorithm for betweenness
+ * centrality", 2001)
+ *
+ * For each source, a forward BFS records the depth of each vertex and the
+ * number of shortest paths from the source to it (sigma). Then the levels are
+ * revisited in reverse to accumulate the dependency of the source on each
+ * vertex (delta), which is added to the score of the vertex.
+ *
+ * Running from every vertex gives the exact scores. Running from a random
+ * sample of k sources and scaling by n/k gives an unbiased estimate (Bader et
+ * al., "Approximating betweenness centrality", 2007).
+ *
+ * The graph is undirected, so every pair of vertices is counted in both
+ * directions.
+ */
+class betweenness
+{
+private:
+    emu::repl<graph*> g_;
+    // Distance from the current source, or -1 if not reached
+    emu::striped_array<long> depth_;
+    // Number of shortest paths from the current source
+    emu::striped_array<double> sigma_;
+    // Dependency of the current source on each vertex
+    emu::striped_array<double> delta_;
+    // Betweenness score of each vertex, summed over all sources
+    emu::striped_array<double> scores_;
+    // Vertices reached from the current source, in BFS order. Every level is
+    // kept, so the windows can be moved back to revisit them in reverse.
+    chunked_queue queue_;
+    // Start and end of the window on each nodelet, for each level
+    std::vector<long> level_bounds_;
+    // Number of edges out of the vertices reached from the current source
+    emu::repl<long> num_edges_;
+    // Sources used in the last call to run
+    std::vector<long> sources_;
+
+    worklist<graph::edge_type> worklist_;
+
+    void save_level();
+    void restore_level(long level);
+    void discover(long level);
+    void count_paths(long level);
+    void accumulate(long level);
+    long add_source(long source);
+
+public:
+    explicit betweenness(graph & g);
+    betweenness(const betweenness& other, emu::shallow_copy);
+
+    /**
+     * Adds the dependencies on each source to the scores, then scales them
+     * by num_vertices / num_sources. Pass every vertex for exact scores.
+     * @param sources Source vertices, without duplicates
+     * @return Number of edges traversed, summed over all sources
+     */
+    long run(const std::vector<long> & sources);
+    void clear();
+    bool check();
+    void dump();
+
+    double operator[] (long v) const { return scores_[v]; }
+};
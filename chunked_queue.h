@@ -0,0 +1,372 @@
+#pragma once
+
+#include <cassert>
+#include <cstdio>
+#include <algorithm>
+#include <exception>
+#include <emu_cxx_utils/replicated.h>
+#include <emu_cxx_utils/repl_array.h>
+#include <emu_cxx_utils/for_each.h>
+#include <emu_cxx_utils/intrinsics.h>
+#include <emu_cxx_utils/out_of_memory.h>
+#include <emu_cxx_utils/pointer_manipulation.h>
+
+/**
+ * Variant of sliding_queue that grows on demand.
+ *
+ * sliding_queue gives each nodelet a fixed share of the vertices, so a
+ * nodelet that receives more than its share of a frontier writes past the end
+ * of its buffer. Here each nodelet stores its items in fixed-size chunks,
+ * which are allocated locally as the queue grows. The chunk table has room
+ * for every vertex in the graph on every nodelet; pushing past that means a
+ * vertex was pushed more than once, and terminates the program.
+ *
+ * Items are pushed one at a time with push_back, or through a pusher, which
+ * collects items privately and reserves slots for the whole batch with a
+ * single atomic.
+ */
+class chunked_queue
+{
+private:
+    // Index of next available slot in the queue
+    long next_;
+    // Start and end of the current window
+    long start_;
+    long end_;
+    // Number of items in each chunk
+    long chunk_size_;
+    // Max number of chunks on each nodelet
+    long max_chunks_;
+    // Pointers to the chunks on each nodelet, null until allocated
+    emu::repl_array<long*> chunks_;
+    // Pointer to the copy of the chunk table that is local to this nodelet
+    long ** chunks_ptr_;
+
+    static long
+    default_chunk_size(long size)
+    {
+        // Four chunks cover an even share of the vertices
+        long share = (size + NODELETS() - 1) / NODELETS();
+        return share / 4 > 0 ? share / 4 : 1;
+    }
+
+    // Allocate a chunk on the same nodelet as the specified pointer
+    long *
+    allocate_chunk(void * localto)
+    {
+        auto chunk = reinterpret_cast<long*>(
+            mw_localmalloc(sizeof(long) * chunk_size_, localto));
+        if (!chunk) { EMU_OUT_OF_MEMORY(sizeof(long) * chunk_size_); }
+        return chunk;
+    }
+
+    // Returns a pointer to chunk c, allocating it if this is the first use
+    long *
+    get_chunk(long c)
+    {
+        long * chunk = chunks_ptr_[c];
+        if (chunk == nullptr) {
+            // Another thread may be allocating the same chunk, use theirs
+            // if they get there first
+            long * new_chunk = allocate_chunk(this);
+            chunk = emu::atomic_cas<long*>(&chunks_ptr_[c], nullptr, new_chunk);
+            if (chunk == nullptr) {
+                chunk = new_chunk;
+            } else {
+                mw_free(new_chunk);
+            }
+        }
+        return chunk;
+    }
+
+    // Atomically reserve count slots, and make sure they have storage
+    long
+    reserve(long count)
+    {
+        long pos = emu::atomic_addms(&next_, count);
+        // Always check, a silent overflow corrupts the queue
+        if (pos + count > max_chunks_ * chunk_size_) {
+            printf("chunked_queue overflow: %li items on nodelet %li, "
+                   "capacity is %li\n", pos + count,
+                   emu::pmanip::get_nodelet(this), max_chunks_ * chunk_size_);
+            fflush(stdout);
+            std::terminate();
+        }
+        for (long c = pos / chunk_size_;
+             c <= (pos + count - 1) / chunk_size_; ++c) {
+            get_chunk(c);
+        }
+        return pos;
+    }
+
+    long &
+    slot(long i)
+    {
+        return chunks_ptr_[i / chunk_size_][i % chunk_size_];
+    }
+
+public:
+    /**
+     * @param size Max number of items that can be in the queue at once, i.e.
+     * the number of vertices in the graph
+     */
+    explicit chunked_queue(long size)
+    : next_(0)
+    , start_(0)
+    , end_(0)
+    , chunk_size_(default_chunk_size(size))
+    , max_chunks_((size + chunk_size_ - 1) / chunk_size_)
+    , chunks_(max_chunks_ > 0 ? max_chunks_ : 1)
+    , chunks_ptr_(chunks_.get_localto(this))
+    {
+        // Allocate enough chunks up front for an even share of the vertices,
+        // so the queue only grows on nodelets that get more than that
+        long initial = (size + NODELETS() - 1) / NODELETS();
+        long initial_chunks = (initial + chunk_size_ - 1) / chunk_size_;
+        for (long n = 0; n < NODELETS(); ++n) {
+            long ** chunks = chunks_.get_nth(n);
+            for (long c = 0; c < chunks_.size(); ++c) {
+                chunks[c] = c < initial_chunks
+                    ? allocate_chunk(chunks) : nullptr;
+            }
+        }
+        reset();
+    }
+
+    // Shallow copy constructor
+    chunked_queue(const chunked_queue& other, emu::shallow_copy shallow)
+    : next_(other.next_)
+    , start_(other.start_)
+    , end_(other.end_)
+    , chunk_size_(other.chunk_size_)
+    , max_chunks_(other.max_chunks_)
+    , chunks_(other.chunks_, shallow)
+    , chunks_ptr_(chunks_.get_localto(this))
+    {}
+
+    ~chunked_queue()
+    {
+        for (long n = 0; n < NODELETS(); ++n) {
+            long ** chunks = chunks_.get_nth(n);
+            for (long c = 0; c < chunks_.size(); ++c) {
+                if (chunks[c]) { mw_free(chunks[c]); }
+            }
+        }
+    }
+
+    void
+    reset()
+    {
+        next_ = 0;
+        start_ = 0;
+        end_ = 0;
+    }
+
+    void
+    reset_all()
+    {
+        // Call reset on each copy of the queue
+        emu::repl_for_each(emu::parallel_policy<8>(), *this,
+            [](chunked_queue& self) { self.reset(); });
+    }
+
+    // Returns a reference to the copy of T on the Nth nodelet
+    chunked_queue&
+    get_nth(long n)
+    {
+        return *emu::pmanip::get_nth(this, n);
+    }
+
+    /**
+     * Move the window forward to cover everything pushed since the last call.
+     * Any pusher used to fill the queue must be flushed (i.e. destroyed)
+     * before this is called, or its items will show up in a later window.
+     */
+    void
+    slide_window()
+    {
+        start_ = end_;
+        end_ = next_;
+    }
+
+    void
+    slide_all_windows()
+    {
+        // Call slide_window on each replicated copy
+        emu::repl_for_each(emu::parallel_policy<8>(), *this,
+            [](chunked_queue& self) { self.slide_window(); });
+    }
+
+    // Start and end of the current window, to pass to set_window later
+    long window_start() const { return start_; }
+    long window_end() const { return end_; }
+
+    /**
+     * Move the window back to a range returned by window_start/window_end.
+     * Items are not overwritten until the next reset, so earlier windows can
+     * be visited again.
+     */
+    void
+    set_window(long start, long end)
+    {
+        assert(start <= end && end <= next_);
+        start_ = start;
+        end_ = end;
+    }
+
+    void
+    push_back(long v)
+    {
+        slot(reserve(1)) = v;
+    }
+
+    /**
+     * Thread-private batch of items to be pushed to the queue.
+     *
+     * Like array_worklist::appender, this is meant to be captured by value
+     * in a mutable lambda. Each vertex goes to the queue on the nodelet where
+     * it lives. The batch is flushed with a single atomic when it fills up,
+     * when a vertex from another nodelet is pushed, and when the pusher goes
+     * out of scope.
+     */
+    class pusher
+    {
+    private:
+        static constexpr long buffer_size = 8;
+        chunked_queue * q_;
+        long nlet_;
+        long count_;
+        long items_[buffer_size];
+    public:
+        explicit pusher(chunked_queue * q)
+        : q_(q), nlet_(-1), count_(0) {}
+
+        // Copy constructor: refer to the same queue, but start empty
+        pusher(const pusher& other) : pusher(other.q_) {}
+
+        // Destructor: copy buffered items to the queue
+        ~pusher() { flush(); }
+
+        void operator()(long v)
+        {
+            long nlet = v & (NODELETS()-1);
+            if (nlet != nlet_ || count_ == buffer_size) {
+                flush();
+                nlet_ = nlet;
+            }
+            items_[count_++] = v;
+        }
+
+        void flush()
+        {
+            if (count_ == 0) { return; }
+            chunked_queue & q = q_->get_nth(nlet_);
+            long pos = q.reserve(count_);
+            for (long i = 0; i < count_; ++i) {
+                q.slot(pos + i) = items_[i];
+            }
+            count_ = 0;
+        }
+    };
+
+    /**
+     * Returns a pusher that can be used to add vertices to this queue
+     * without doing an atomic for every item.
+     * Only valid to call on a replicated instance
+     */
+    pusher
+    make_pusher()
+    {
+        assert(emu::pmanip::is_repl(this));
+        return pusher(this);
+    }
+
+    bool
+    is_empty()
+    {
+        return start_ == end_;
+    }
+
+    long
+    size()
+    {
+        return end_ - start_;
+    }
+
+    bool
+    all_empty()
+    {
+        for (long n = 0; n < NODELETS(); ++n) {
+            if (!get_nth(n).is_empty()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    long
+    combined_size()
+    {
+        long size = 0;
+        emu::repl_for_each(emu::parallel_policy<8>(), *this,
+            [&size](chunked_queue& self) {
+                emu::remote_add(&size, self.size());
+            }
+        );
+        return size;
+    }
+
+    void
+    dump()
+    {
+        for (long i = start_; i < end_; ++i) {
+            printf("%li ", slot(i));
+        }
+    }
+
+    void
+    dump_all()
+    {
+        // Call dump() on each copy
+        emu::repl_for_each(emu::seq, *this,
+            [](chunked_queue& self) { self.dump(); });
+    }
+
+private:
+    template<class Function>
+    void forall_slots(bool whole_queue, Function worker)
+    {
+        // First, spawn a thread on each nodelet to handle the local queue
+        emu::repl_for_each(emu::parallel_policy<1>(), *this,
+            [&](chunked_queue& queue){
+                long first = whole_queue ? 0 : queue.start_;
+                long last = whole_queue ? queue.next_ : queue.end_;
+                // Spawn threads to dynamically pull items off of each chunk
+                // that overlaps the range
+                long c = queue.chunk_size_;
+                for (long i = first; i < last; i = (i / c + 1) * c) {
+                    long * begin = &queue.slot(i);
+                    long n = std::min((i / c + 1) * c, last) - i;
+                    cilk_spawn emu::parallel::for_each(
+                        emu::dyn, begin, begin + n, worker
+                    );
+                }
+            }
+        );
+    }
+
+public:
+    // Call worker on each item in the current window
+    template<class Function>
+    void forall_items(Function worker)
+    {
+        forall_slots(false, worker);
+    }
+
+    // Call worker on each item pushed since the last reset, in any window
+    template<class Function>
+    void forall_pushed(Function worker)
+    {
+        forall_slots(true, worker);
+    }
+};
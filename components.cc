@@ -4,7 +4,10 @@
 #include <emu_c_utils/emu_c_utils.h>
 #include <queue>
 #include <unordered_map>
+#include <algorithm>
 #include <emu_cxx_utils/fill.h>
+#include <emu_cxx_utils/fileset.h>
+#include "lcg.h"
 
 using namespace emu;
 using namespace emu::parallel;
@@ -13,6 +16,10 @@ using namespace emu::parallel;
 components::components(graph & g)
 : g_(&g)
 , worklist_(g.num_vertices())
+, num_edges_processed_(0L)
+, num_active_(0L)
+, last_component_(g.num_vertices())
+, roots_(g.num_vertices())
 , component_(g.num_vertices())
 , component_size_(g.num_vertices())
 , num_components_(g.num_vertices())
@@ -24,6 +31,10 @@ components::components(graph & g)
 components::components(const components& other, emu::shallow_copy shallow)
 : g_(other.g_)
 , worklist_(other.worklist_, shallow)
+, num_edges_processed_(other.num_edges_processed_)
+, num_active_(other.num_active_)
+, last_component_(other.last_component_, shallow)
+, roots_(other.roots_, shallow)
 , component_(other.component_, shallow)
 , component_size_(other.component_size_, shallow)
 , num_components_(other.num_components_)
@@ -39,21 +50,24 @@ components::stats
 components::run()
 {
     worklist_.clear_all();
-    for_each(fixed, g_->vertices_begin(), g_->vertices_end(), [this] (long v){
+    for_each(fixed, g_->vertices_begin(), g_->vertices_end(),
+        [this, append=worklist_.make_appender()] (long v) mutable {
         // Put each vertex in its own component
         component_[v] = v;
         // Set size of each component to zero
         component_size_[v] = 0;
         // Build the worklist for the first iteration
         // Later, we do this during the tree-climbing step
-        worklist_.append(v, g_->out_edges_begin(v), g_->out_edges_end(v));
+        append(v, g_->out_edges_begin(v), g_->out_edges_end(v));
     });
 
+    stats s;
+    s.num_edges_stolen = 0;
     long num_iters;
     for (num_iters = 1; ; ++num_iters) {
         changed_ = false;
         // For all edges that connect vertices in different components...
-        worklist_.process_all_edges(dynamic_policy<64>(),
+        worklist_.process_all_edges(stealing_policy<64>(),
             [this](long src, long dst) {
                 long &comp_src = component_[src];
                 long &comp_dst = component_[dst];
@@ -63,28 +77,152 @@ components::run()
                 }
             }
         );
+        s.num_edges_stolen += worklist_.get_steal_stats().num_edges_stolen;
 
         // No changes? We're done!
         if (!repl_reduce(changed_, std::logical_or<>())) break;
 
         worklist_.clear_all();
-        g_->for_each_vertex(fixed, [this](long v) {
+        g_->for_each_vertex(fixed,
+            [this, append=worklist_.make_appender()](long v) mutable {
             // Merge connected components
             while (component_[v] != component_[component_[v]]) {
                 component_[v] = component_[component_[v]];
             }
             // Add this vertex to the worklist for the next step
-            worklist_.append(v, g_->out_edges_begin(v), g_->out_edges_end(v));
+            append(v, g_->out_edges_begin(v), g_->out_edges_end(v));
         });
     }
+    s.num_iters = num_iters;
+    s.num_edges_traversed = num_iters * g_->num_edges();
+    s.num_components = count_components();
+    return s;
+}
+
+components::stats
+components::run_frontier()
+{
+    worklist_.clear_all();
+    num_edges_processed_ = 0;
+    for_each(fixed, g_->vertices_begin(), g_->vertices_end(),
+        [this, append=worklist_.make_appender()] (long v) mutable {
+        component_[v] = v;
+        last_component_[v] = v;
+        component_size_[v] = 0;
+        // Every vertex is active in the first iteration
+        remote_add(&num_edges_processed_, g_->out_degree(v));
+        append(v, g_->out_edges_begin(v), g_->out_edges_end(v));
+    });
+
+    stats s;
+    s.num_edges_stolen = 0;
+    s.num_edges_traversed = 0;
+    long num_active = g_->num_vertices();
+    long num_iters;
+    for (num_iters = 1; ; ++num_iters) {
+        long num_edges = repl_reduce(num_edges_processed_, std::plus<>());
+        LOG("Iteration %li: %li active vertices, %li edges\n",
+            num_iters, num_active, num_edges);
+        s.num_edges_traversed += num_edges;
+
+        // Move the smaller label across each edge out of an active vertex.
+        // Labels only decrease, so neither endpoint can go back up.
+        worklist_.process_all_edges(stealing_policy<64>(),
+            [this](long src, long dst) {
+                long comp_src = component_[src];
+                long comp_dst = component_[dst];
+                if (comp_dst < comp_src) {
+                    remote_min(&component_[src], comp_dst);
+                } else if (comp_src < comp_dst) {
+                    remote_min(&component_[dst], comp_src);
+                }
+            }
+        );
+        s.num_edges_stolen += worklist_.get_steal_stats().num_edges_stolen;
+
+        // Compress, then activate every vertex whose label changed
+        changed_ = false;
+        num_active_ = 0;
+        num_edges_processed_ = 0;
+        worklist_.clear_all();
+        g_->for_each_vertex(fixed,
+            [this, append=worklist_.make_appender()](long v) mutable {
+            while (component_[v] != component_[component_[v]]) {
+                component_[v] = component_[component_[v]];
+            }
+            if (component_[v] != last_component_[v]) {
+                last_component_[v] = component_[v];
+                changed_ = true;
+                remote_add(&num_active_, 1);
+                remote_add(&num_edges_processed_, g_->out_degree(v));
+                append(v, g_->out_edges_begin(v), g_->out_edges_end(v));
+            }
+        });
+
+        // No changes? We're done!
+        if (!repl_reduce(changed_, std::logical_or<>())) break;
+        num_active = repl_reduce(num_active_, std::plus<>());
+    }
+    s.num_iters = num_iters;
+    s.num_components = count_components();
+    return s;
+}
+
+long
+components::find(long v)
+{
+    for (;;) {
+        long parent = component_[v];
+        long grandparent = component_[parent];
+        if (parent == grandparent) { return parent; }
+        // Skip a level. If this fails, someone else already moved it up.
+        atomic_cas(&component_[v], parent, grandparent);
+        v = grandparent;
+    }
+}
+
+long
+components::add_edges(dist_edge_list& batch)
+{
+    // Hang the higher root under the lower one
+    batch.forall_edges(fixed,
+        [this, push=roots_.make_pusher()](long u, long v) mutable {
+        long root_u = find(u);
+        long root_v = find(v);
+        while (root_u != root_v) {
+            long high = root_u > root_v ? root_u : root_v;
+            long low = root_u + root_v - high;
+            if (atomic_cas(&component_[high], high, low) == high) {
+                push(high);
+                break;
+            }
+            // high was merged by someone else, find the new roots
+            root_u = find(high);
+            root_v = find(low);
+        }
+    });
+
+    // Move the size of each merged root to the root of its new tree. Only
+    // the final roots are added to, so the merged sizes are stable here.
+    roots_.forall_pushed([this](long r) {
+        long size = component_size_[r];
+        component_size_[r] = 0;
+        remote_add(&component_size_[find(r)], size);
+        remote_add(&num_components_, -1);
+    });
+    roots_.reset_all();
+    return emu::repl_reduce(num_components_, std::plus<>());
+}
+
+// Fill in component_size_ and return the number of components
+long
+components::count_components()
+{
     // Count up the size of each component
     for_each(fixed, component_.begin(), component_.end(),
         [this](long c) { emu::remote_add(&component_size_[c], 1); }
     );
 
-    stats s;
-    s.num_iters = num_iters;
-
     // TODO should use parallel count_if here (can use transform_reduce)
     // s.num_components = parallel::count_if(
     //     component_size_.begin(), component_size_.end(),
@@ -98,55 +236,216 @@ components::run()
             if (size > 0) { emu::remote_add(&num_components_, 1); }
         }
     );
-    s.num_components = emu::repl_reduce(num_components_, std::plus<>());
+    return emu::repl_reduce(num_components_, std::plus<>());
+}
 
+/**
+ * Merge the trees containing u and v, by pointing the higher of the two roots
+ * at the lower one. Every vertex's label only ever decreases, so the root of
+ * each tree is its lowest vertex.
+ */
+void
+components::link(long u, long v)
+{
+    long p1 = component_[u];
+    long p2 = component_[v];
+    while (p1 != p2) {
+        long high = p1 > p2 ? p1 : p2;
+        long low = p1 + p2 - high;
+        long p_high = component_[high];
+        // Already linked by someone else
+        if (p_high == low) { break; }
+        // high is still a root, try to hang it under low
+        if (p_high == high && atomic_cas(&component_[high], high, low) == high) {
+            break;
+        }
+        // Lost the race or high was not a root, climb and try again
+        p1 = component_[component_[high]];
+        p2 = component_[low];
+    }
+}
+
+// Point every vertex directly at the root of its tree
+void
+components::compress()
+{
+    g_->for_each_vertex(fixed, [this](long v) {
+        while (component_[v] != component_[component_[v]]) {
+            component_[v] = component_[component_[v]];
+        }
+    });
+}
+
+// Returns the component label that appears most often in a random sample
+long
+components::sample_frequent_component(long num_samples)
+{
+    std::unordered_map<long, long> counts;
+    lcg rng(0);
+    long best = 0, best_count = 0;
+    for (long i = 0; i < num_samples; ++i) {
+        long c = component_[rng() % g_->num_vertices()];
+        long count = ++counts[c];
+        if (count > best_count) {
+            best = c;
+            best_count = count;
+        }
+    }
+    return best;
+}
+
+components::stats
+components::run_afforest(long neighbor_rounds)
+{
+    num_edges_processed_ = 0;
+    for_each(fixed, g_->vertices_begin(), g_->vertices_end(), [this](long v) {
+        component_[v] = v;
+        component_size_[v] = 0;
+    });
+
+    // Link each vertex to its first few neighbors, one at a time
+    for (long r = 0; r < neighbor_rounds; ++r) {
+        g_->for_each_vertex(fixed, [this, r](long v) {
+            if (g_->out_degree(v) > r) {
+                link(v, g_->out_neighbors(v)[r]);
+                remote_add(&num_edges_processed_, 1);
+            }
+        });
+        compress();
+    }
+
+    // Skip the rest of the edges of the largest intermediate component
+    long skip = sample_frequent_component(1024);
+    worklist_.clear_all();
+    g_->for_each_vertex(fixed,
+        [this, skip, neighbor_rounds, append=worklist_.make_appender()]
+        (long v) mutable {
+        if (component_[v] != skip && g_->out_degree(v) > neighbor_rounds) {
+            remote_add(&num_edges_processed_, g_->out_degree(v) - neighbor_rounds);
+            append(v, g_->out_edges_begin(v) + neighbor_rounds,
+                g_->out_edges_end(v));
+        }
+    });
+    worklist_.process_all_edges(stealing_policy<64>(),
+        [this](long src, long dst) { link(src, dst); }
+    );
+    compress();
+
+    stats s;
+    s.num_iters = neighbor_rounds + 1;
+    s.num_edges_stolen = worklist_.get_steal_stats().num_edges_stolen;
+    s.num_edges_traversed = repl_reduce(num_edges_processed_, std::plus<>());
+    s.num_components = count_components();
     return s;
 }
 
+// Add the number of components in each size range to counts
 void
-components::dump()
+components::size_histogram(long * counts)
 {
-    long max_component = *std::max_element(component_.begin(), component_.end());
+    for (long i = 0; i < num_size_buckets; ++i) { counts[i] = 0; }
+    for_each(fixed, component_size_.begin(), component_size_.end(),
+        [counts](long size) {
+            if (size > 0) {
+                emu::remote_add(&counts[63 - __builtin_clzl(size)], 1);
+            }
+        }
+    );
+}
 
-    auto print_range = [](bool first_entry, long c, long first, long last) {
-        if (first_entry) {
-            printf("Component %li: ", c);
-        } else {
-            printf(", ");
+void
+components::print_histogram()
+{
+    long counts[num_size_buckets];
+    size_histogram(counts);
+    for (long i = 0; i < num_size_buckets; ++i) {
+        if (counts[i] > 0) {
+            LOG("Components with %li-%li vertices: %li\n",
+                1L << i, (2L << i) - 1, counts[i]);
         }
-        if (first == last) {
-            printf("%li", first);
-        } else {
-            printf("%li-%li", first, last);
+    }
+}
+
+std::vector<long>
+components::largest_components(long k)
+{
+    // Use the histogram to find a size that at least k components reach
+    long counts[num_size_buckets];
+    size_histogram(counts);
+    long min_bucket = num_size_buckets - 1;
+    for (long total = 0; min_bucket > 0; --min_bucket) {
+        total += counts[min_bucket];
+        if (total >= k) { break; }
+    }
+    long min_size = 1L << min_bucket;
+
+    // Collect the roots of all components at least that big
+    g_->for_each_vertex(fixed,
+        [this, min_size, push=roots_.make_pusher()](long v) mutable {
+        if (component_size_[v] >= min_size) { push(v); }
+    });
+    roots_.slide_all_windows();
+    std::vector<long> roots(roots_.combined_size());
+    long * roots_ptr = roots.data();
+    long num_roots = 0;
+    long * num_roots_ptr = &num_roots;
+    roots_.forall_items([roots_ptr, num_roots_ptr](long r) {
+        roots_ptr[emu::atomic_addms(num_roots_ptr, 1)] = r;
+    });
+    roots_.reset_all();
+
+    // Only the candidates need to be sorted
+    k = std::min(k, (long)roots.size());
+    std::partial_sort(roots.begin(), roots.begin() + k, roots.end(),
+        [this](long a, long b) {
+            long size_a = component_size_[a];
+            long size_b = component_size_[b];
+            return size_a != size_b ? size_a > size_b : a < b;
         }
-    };
-
-    // For each component...
-    for (long c = 0; c <= max_component; ++c) {
-        long range_start = -1;
-        bool first_entry = true;
-        for (long v = 0; v < g_->num_vertices(); ++v) {
-            // Is the vertex in the component?
-            if (c == component_[v]) {
-                // Record the start of a range of vertices
-                if (range_start < 0) { range_start = v; }
+    );
+    roots.resize(k);
+    return roots;
+}
+
+void
+components::export_labels(const char* filename)
+{
+    // Labels may still point at intermediate vertices after add_edges
+    compress();
+    emu::fileset files(filename, "wb");
+    serialize(files, component_);
+}
+
+void
+components::dump()
+{
+    // Chain together the vertices in each component, in increasing order
+    long n = g_->num_vertices();
+    std::vector<long> first(n, -1);
+    std::vector<long> next(n, -1);
+    for (long v = n - 1; v >= 0; --v) {
+        long c = component_[v];
+        next[v] = first[c];
+        first[c] = v;
+    }
+
+    // For each component, print its vertices as ranges where possible
+    for (long c = 0; c < n; ++c) {
+        if (first[c] < 0) { continue; }
+        printf("Component %li: ", c);
+        long v = first[c];
+        while (v >= 0) {
+            long range_start = v;
+            while (next[v] == v + 1) { v = next[v]; }
+            if (range_start != first[c]) { printf(", "); }
+            if (range_start == v) {
+                printf("%li", v);
             } else {
-                // End of the range
-                if (range_start >= 0) {
-                    // Print start of line only once, omit for empty components
-                    // Print vertices as a range if possible
-                    print_range(first_entry, c, range_start, v - 1);
-                    // Reset range
-                    range_start = -1;
-                    first_entry = false;
-                }
+                printf("%li-%li", range_start, v);
             }
+            v = next[v];
         }
-        // Print last range
-        if (range_start >= 0) {
-            print_range(first_entry, c, range_start, g_->num_vertices() - 1);
-        }
-        if (!first_entry) { printf("\n"); }
+        printf("\n");
         fflush(stdout);
     }
 }
@@ -158,15 +457,15 @@ components::check()
     // Make sure we reach each vertex at least once
     std::vector<long> visited(g_->num_vertices(), 0);
 
-    // Build a map from component labels to a vertex in that component
-    std::unordered_map<long, long> label_to_source;
+    // Labels are vertex ID's, so map each label to a vertex in that component
+    std::vector<long> label_to_source(g_->num_vertices(), -1);
     for (long v = 0; v < g_->num_vertices(); ++v) {
         label_to_source[component_[v]] = v;
     }
 
-    for (auto p : label_to_source) {
-        long my_component = p.first;
-        long source = p.second;
+    for (long my_component = 0; my_component < g_->num_vertices(); ++my_component) {
+        long source = label_to_source[my_component];
+        if (source < 0) { continue; }
         visited[source] = 1;
 
         // Do a serial BFS
@@ -1,12 +1,32 @@
+#pragma once
+
+#include <vector>
 #include <emu_cxx_utils/replicated.h>
 #include "graph.h"
+#include "dist_edge_list.h"
 #include "worklist.h"
+#include "chunked_queue.h"
 
 class components
 {
 private:
     emu::repl<graph*> g_;
     worklist<graph::edge_type> worklist_;
+    // Number of edges processed in the current step
+    emu::repl<long> num_edges_processed_;
+    // Number of vertices whose label changed in the current iteration
+    emu::repl<long> num_active_;
+    // Label of each vertex at the end of the previous iteration
+    emu::striped_array<long> last_component_;
+    // Scratch list of component roots: the roots merged by add_edges, or the
+    // candidates for largest_components
+    chunked_queue roots_;
+
+    void link(long u, long v);
+    void compress();
+    long sample_frequent_component(long num_samples);
+    long count_components();
+    void size_histogram(long * counts);
 public:
     // Component that this vertex belongs to
     emu::striped_array<long> component_;
@@ -25,8 +45,72 @@ public:
         long num_components;
         // Number of iterations required for convergence
         long num_iters;
+        // Number of edges that were processed by a worker from another
+        // nodelet, summed over all iterations
+        long num_edges_stolen;
+        // Number of edges processed, summed over all iterations
+        long num_edges_traversed;
     };
+    // Number of buckets in the size histogram, bucket i is [2^i, 2^(i+1))
+    static const long num_size_buckets = 64;
+
     stats run();
+
+    /**
+     * Afforest (Sutton et al., "Optimizing Parallel Graph Connectivity
+     * Computation via Subgraph Sampling", 2018)
+     *
+     * Links each vertex to its first few neighbors and compresses, which is
+     * usually enough to find most of the largest component. Then only the
+     * vertices outside the most frequent component link their remaining
+     * edges. The graph is undirected, so an edge into the large component
+     * is still seen from the vertex at the other end.
+     * @param neighbor_rounds Number of neighbors to link before sampling
+     */
+    stats run_afforest(long neighbor_rounds = 2);
+
+    /**
+     * Label propagation that only rescans the edges of vertices whose label
+     * changed in the previous iteration, whether by taking a neighbor's
+     * label or by pointer jumping. The smaller label is pushed or pulled
+     * across each edge, so neighbors of a changed vertex are updated too,
+     * and become active in turn.
+     */
+    stats run_frontier();
+
+    /**
+     * Merge the components joined by a batch of new edges, in time
+     * proportional to the size of the batch.
+     *
+     * Labels form a union-find forest, with every vertex pointing at a lower
+     * vertex in the same component and the lowest vertex as the root. The
+     * algorithms above leave the forest flat, so any of them can seed it.
+     * Afterwards, use find to get the label of a vertex; component_ is
+     * only compressed along the paths that were followed.
+     *
+     * Edges are not added to the graph.
+     * @return Number of components after the batch
+     */
+    long add_edges(dist_edge_list& batch);
+
+    // Root of the tree containing v, halving the path along the way
+    long find(long v);
+
+    // Print the number of components in each power-of-two size range
+    void print_histogram();
+
+    /**
+     * Returns the roots of the k largest components, largest first.
+     * Ties are broken by the lower root.
+     */
+    std::vector<long> largest_components(long k);
+
+    /**
+     * Write the label of each vertex to a fileset, with each nodelet writing
+     * its own slice in parallel. The files can be read back into a
+     * striped_array with deserialize().
+     */
+    void export_labels(const char* filename);
     void dump();
     void clear();
     bool check();
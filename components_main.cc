@@ -6,16 +6,22 @@
 #include "dist_edge_list.h"
 #include "components.h"
 #include "git_sha1.h"
+#include <emu_cxx_utils/fileset.h>
 
 const struct option long_options[] = {
     {"graph_filename"   , required_argument},
     {"distributed_load" , no_argument},
     {"num_trials"       , required_argument},
+    {"algorithm"        , required_argument},
+    {"num_batches"      , required_argument},
     {"dump_edge_list"   , no_argument},
     {"check_graph"      , no_argument},
     {"dump_graph"       , no_argument},
     {"check_results"    , no_argument},
     {"dump_results"     , no_argument},
+    {"histogram"        , no_argument},
+    {"top_k"            , required_argument},
+    {"export_labels"    , required_argument},
     {"help"             , no_argument},
     {nullptr}
 };
@@ -27,11 +33,17 @@ print_help(const char* argv0)
     LOG("\t--graph_filename     Path to graph file to load\n");
     LOG("\t--distributed_load   Load the graph from all nodes at once (File must exist on all nodes, use absolute path).\n");
     LOG("\t--num_trials         Run the algorithm this many times.\n");
+    LOG("\t--algorithm          Select connected components implementation to run\n");
+    LOG("\t                     (label_propagation, frontier or afforest)\n");
+    LOG("\t--num_batches        Also find components of half the edges, then add the rest in this many batches\n");
     LOG("\t--dump_edge_list     Print the edge list to stdout after loading (slow)\n");
     LOG("\t--check_graph        Validate the constructed graph against the edge list (slow)\n");
     LOG("\t--dump_graph         Print the graph to stdout after construction (slow)\n");
     LOG("\t--check_results      Validate the results (slow)\n");
     LOG("\t--dump_results       Print the results to stdout (slow)\n");
+    LOG("\t--histogram          Print the number of components in each size range\n");
+    LOG("\t--top_k              Print the sizes of the k largest components\n");
+    LOG("\t--export_labels      Write the component of each vertex to a fileset with this name\n");
     LOG("\t--version            Print git version info\n");
     LOG("\t--help               Print command line help\n");
 }
@@ -41,11 +53,16 @@ struct components_args
     const char* graph_filename;
     bool distributed_load;
     long num_trials;
+    const char* algorithm;
+    long num_batches;
     bool dump_edge_list;
     bool check_graph;
     bool dump_graph;
     bool check_results;
     bool dump_results;
+    bool histogram;
+    long top_k;
+    const char* export_labels;
 
     static components_args
     parse(int argc, char *argv[])
@@ -54,11 +71,16 @@ struct components_args
         args.graph_filename = NULL;
         args.distributed_load = false;
         args.num_trials = 1;
+        args.algorithm = "label_propagation";
+        args.num_batches = 0;
         args.dump_edge_list = false;
         args.check_graph = false;
         args.dump_graph = false;
         args.check_results = false;
         args.dump_results = false;
+        args.histogram = false;
+        args.top_k = 0;
+        args.export_labels = NULL;
 
         int option_index;
         while (true) {
@@ -79,6 +101,10 @@ struct components_args
                 args.distributed_load = true;
             } else if (!strcmp(option_name, "num_trials")) {
                 args.num_trials = atol(optarg);
+            } else if (!strcmp(option_name, "algorithm")) {
+                args.algorithm = optarg;
+            } else if (!strcmp(option_name, "num_batches")) {
+                args.num_batches = atol(optarg);
             } else if (!strcmp(option_name, "dump_edge_list")) {
                 args.dump_edge_list = true;
             } else if (!strcmp(option_name, "check_graph")) {
@@ -89,6 +115,12 @@ struct components_args
                 args.check_results = true;
             } else if (!strcmp(option_name, "dump_results")) {
                 args.dump_results = true;
+            } else if (!strcmp(option_name, "histogram")) {
+                args.histogram = true;
+            } else if (!strcmp(option_name, "top_k")) {
+                args.top_k = atol(optarg);
+            } else if (!strcmp(option_name, "export_labels")) {
+                args.export_labels = optarg;
             } else if (!strcmp(option_name, "version")) {
                 LOG("%s\n", g_GIT_TAG);
                 exit(0);
@@ -99,10 +131,64 @@ struct components_args
         }
         if (args.graph_filename == NULL) { LOG( "Missing graph filename\n"); exit(1); }
         if (args.num_trials <= 0) { LOG( "num_trials must be > 0\n"); exit(1); }
+        if (args.num_batches < 0) { LOG( "num_batches must be >= 0\n"); exit(1); }
+        if (args.top_k < 0) { LOG( "top_k must be >= 0\n"); exit(1); }
         return args;
     }
 };
 
+/**
+ * Find the components of the graph built from the first half of the edges,
+ * then add the rest in batches with components::add_edges.
+ * The result is compared against the components of the whole graph.
+ * Returns false if the check failed.
+ */
+bool
+run_incremental(const components_args& args, dist_edge_list& dist_el,
+    components& reference)
+{
+    long num_edges = dist_el.num_edges();
+    long num_initial = num_edges / 2;
+    LOG("Constructing graph from the first %li edges...\n", num_initial);
+    auto initial_el = dist_el.slice(0, num_initial);
+    auto g = create_graph_from_edge_list<graph>(*initial_el);
+    auto cc = emu::make_repl_shallow<components>(*g);
+    components::stats s = cc->run();
+    LOG("Found %li components in %li iterations\n",
+        s.num_components, s.num_iters);
+
+    long num_components = s.num_components;
+    for (long b = 0; b < args.num_batches; ++b) {
+        long first = num_initial + (num_edges - num_initial) * b / args.num_batches;
+        long last = num_initial + (num_edges - num_initial) * (b + 1) / args.num_batches;
+        auto batch = dist_el.slice(first, last);
+        hooks_set_attr_i64("batch", b);
+        hooks_region_begin("add_edges");
+        num_components = cc->add_edges(*batch);
+        double time_ms = hooks_region_end();
+        LOG("Added batch %li of %li (%li edges) in %3.2f ms, %li components\n",
+            b + 1, args.num_batches, last - first, time_ms, num_components);
+    }
+
+    if (!args.check_results) { return true; }
+    LOG("Checking incremental results...");
+    // Every algorithm labels a component with its lowest vertex
+    for (long v = 0; v < dist_el.num_vertices(); ++v) {
+        long c = cc->find(v);
+        if (c != reference.component_[v]
+         || cc->component_size_[c] != reference.component_size_[c]) {
+            LOG("FAIL\n");
+            LOG("Vertex %li in component %li of size %li, expected %li of size %li\n",
+                v, c, (long)cc->component_size_[c],
+                (long)reference.component_[v],
+                (long)reference.component_size_[reference.component_[v]]);
+            return false;
+        }
+    }
+    LOG("PASS\n");
+    return true;
+}
+
 
 int main(int argc, char ** argv)
 {
@@ -158,6 +244,23 @@ int main(int argc, char ** argv)
         g->dump();
     }
 
+    enum components_alg {
+        LABEL_PROPAGATION,
+        FRONTIER,
+        AFFOREST,
+    } alg;
+    if        (!strcmp(args.algorithm, "label_propagation")) {
+        alg = LABEL_PROPAGATION;
+    } else if (!strcmp(args.algorithm, "frontier")) {
+        alg = FRONTIER;
+    } else if (!strcmp(args.algorithm, "afforest")) {
+        alg = AFFOREST;
+    } else {
+        LOG("Algorithm '%s' not implemented!\n", args.algorithm);
+        exit(1);
+    }
+    hooks_set_attr_str("algorithm", args.algorithm);
+
     // Initialize the algorithm
     LOG("Initializing data structures...\n");
     auto cc = emu::make_repl_shallow<components>(*g);
@@ -171,14 +274,21 @@ int main(int argc, char ** argv)
 
         LOG("Finding connected components...\n");
         hooks_region_begin("components");
-        components::stats s = cc->run();
+        components::stats s = {};
+        switch (alg) {
+            case LABEL_PROPAGATION: s = cc->run(); break;
+            case FRONTIER: s = cc->run_frontier(); break;
+            case AFFOREST: s = cc->run_afforest(); break;
+        }
         hooks_set_attr_i64("num_iters", s.num_iters);
         hooks_set_attr_i64("num_components", s.num_components);
+        hooks_set_attr_i64("num_edges_stolen", s.num_edges_stolen);
         double time_ms = hooks_region_end();
 
-        double teps = s.num_iters * g->num_edges() / (1e-3 * time_ms);
+        double teps = s.num_edges_traversed / (1e-3 * time_ms);
         LOG("Found %li components in %li iterations (%3.2f ms, %3.2f GTEPS)\n",
             s.num_components, s.num_iters, time_ms, 1e-9 * teps);
+        LOG("Stole %li edges from other nodelets\n", s.num_edges_stolen);
     }
 
     if (args.check_results) {
@@ -193,6 +303,50 @@ int main(int argc, char ** argv)
     if (args.dump_results) {
         cc->dump();
     }
+    if (args.histogram) {
+        hooks_region_begin("histogram");
+        cc->print_histogram();
+        double time_ms = hooks_region_end();
+        LOG("Computed histogram in %3.2f ms\n", time_ms);
+    }
+    if (args.top_k > 0) {
+        hooks_region_begin("top_k");
+        std::vector<long> roots = cc->largest_components(args.top_k);
+        double time_ms = hooks_region_end();
+        LOG("Found %li largest components in %3.2f ms\n",
+            (long)roots.size(), time_ms);
+        for (long i = 0; i < (long)roots.size(); ++i) {
+            LOG("%li: component %li with %li vertices\n",
+                i + 1, roots[i], (long)cc->component_size_[roots[i]]);
+        }
+    }
+    if (args.export_labels) {
+        LOG("Exporting labels to %s...\n", args.export_labels);
+        hooks_region_begin("export_labels");
+        cc->export_labels(args.export_labels);
+        double time_ms = hooks_region_end();
+        LOG("Wrote %li labels in %3.2f ms\n", g->num_vertices(), time_ms);
+        if (args.check_results) {
+            LOG("Checking exported labels...");
+            emu::fileset files(args.export_labels, "rb");
+            emu::striped_array<long> labels;
+            deserialize(files, labels);
+            bool match = labels.size() == g->num_vertices();
+            for (long v = 0; match && v < g->num_vertices(); ++v) {
+                match = labels[v] == cc->component_[v];
+            }
+            if (match) {
+                LOG("PASS\n");
+            } else {
+                LOG("FAIL\n");
+                success = false;
+            }
+        }
+    }
+
+    if (args.num_batches > 0) {
+        success = run_incremental(args, *dist_el, *cc) && success;
+    }
 
     return !success;
 }
\ No newline at end of file
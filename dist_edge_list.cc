@@ -2,6 +2,7 @@
 #include "common.h"
 #include "edge_list.h"
 #include <getopt.h>
+#include <cassert>
 #include <cstdio>
 #include <cstring>
 #include <vector>
@@ -20,6 +21,21 @@ dist_edge_list::dump() const
     }
 }
 
+dist_edge_list::handle
+dist_edge_list::slice(long first, long last) const
+{
+    assert(first >= 0 && first <= last && last <= num_edges_);
+    auto el = emu::make_repl_shallow<dist_edge_list>(
+        num_vertices_, last - first);
+    parallel::for_each(fixed, el->src_.begin(), el->src_.end(),
+        [this, &el, first, src_begin=el->src_.begin()](long& src) {
+            long i = &src - src_begin;
+            src = src_[first + i];
+            el->dst_[i] = dst_[first + i];
+        }
+    );
+    return el;
+}
 
 // Check if string has a given suffix
 // Adapted from https://stackoverflow.com/a/874160/2570605
@@ -62,6 +62,9 @@ public:
     static handle
     load_binary(const char* filename);
 
+    // Copy edges [first, last) into a new edge list with the same vertices
+    handle slice(long first, long last) const;
+
     // Print the edge list to stdout for debugging
     void dump() const;
 
@@ -69,7 +72,8 @@ public:
     void forall_edges(Policy policy, Function worker)
     {
         emu::parallel::for_each(policy, src_.begin(), src_.end(),
-            [this, src_begin=src_.begin(), worker](long& src) {
+            // Mutable, so the worker can hold per-thread state
+            [this, src_begin=src_.begin(), worker](long& src) mutable {
                 // HACK Compute index in table from the pointer
                 long i = &src - src_begin;
                 long dst = dst_[i];
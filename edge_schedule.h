@@ -0,0 +1,165 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cilk/cilk.h>
+#include <emu_cxx_utils/replicated.h>
+#include <emu_cxx_utils/repl_array.h>
+#include <emu_cxx_utils/intrinsics.h>
+#include <emu_cxx_utils/execution_policy.h>
+#include "graph.h"
+
+/**
+ * Static, edge-balanced schedule for visiting every edge of a graph.
+ *
+ * For algorithms that visit all the edges every iteration (i.e. PageRank),
+ * rebuilding a worklist each time is wasted work, since the edge set never
+ * changes. This is built once, and can then be replayed with no atomics.
+ *
+ * The edges of each vertex are cut into items of at most grain edges. Like
+ * the split items in worklist, the items of a vertex are dealt out to the
+ * nodelets starting with the one where the vertex lives, so a low-degree
+ * vertex stays on its own nodelet. The items on each nodelet are then cut
+ * into one chunk per worker thread, with about the same number of edges in
+ * each chunk.
+ */
+class edge_schedule
+{
+private:
+    using edge_iterator = graph::edge_iterator;
+
+    // Number of worker threads on each nodelet
+    long num_chunks_;
+    // Items on each nodelet: source vertex and range of edges
+    emu::repl_array<long> src_;
+    emu::repl_array<edge_iterator> begin_;
+    emu::repl_array<edge_iterator> end_;
+    // Index of the first item in each chunk on each nodelet, plus the total
+    emu::repl_array<long> bounds_;
+    // Pointers to the copy of each array that is local to this nodelet
+    long * src_ptr_;
+    edge_iterator * begin_ptr_;
+    edge_iterator * end_ptr_;
+    long * bounds_ptr_;
+
+    static long
+    num_items(long degree, long grain)
+    {
+        return (degree + grain - 1) / grain;
+    }
+
+    // Count the items that will land on each nodelet
+    static long
+    max_items_per_nodelet(graph & g, long grain)
+    {
+        std::vector<long> counts(NODELETS(), 0);
+        long * counts_ptr = counts.data();
+        g.for_each_vertex(emu::fixed, [&g, grain, counts_ptr](long v) {
+            long n = num_items(g.out_degree(v), grain);
+            for (long k = 0; k < n; ++k) {
+                emu::remote_add(&counts_ptr[(v + k) & (NODELETS() - 1)], 1);
+            }
+        });
+        return std::max(1L, *std::max_element(counts.begin(), counts.end()));
+    }
+
+    template<class Visitor>
+    void
+    process_chunk(long c, Visitor visitor)
+    {
+        for (long i = bounds_ptr_[c]; i < bounds_ptr_[c + 1]; ++i) {
+            visitor(src_ptr_[i], begin_ptr_[i], end_ptr_[i]);
+        }
+    }
+
+public:
+    /**
+     * @param g Graph to schedule. Edges must not be added or removed after
+     * the schedule is built.
+     * @param grain Max number of edges in each item
+     */
+    edge_schedule(graph & g, long grain)
+    : num_chunks_(emu::threads_per_nodelet)
+    , src_(max_items_per_nodelet(g, grain))
+    , begin_(src_.size())
+    , end_(src_.size())
+    , bounds_(num_chunks_ + 1)
+    , src_ptr_(src_.get_localto(this))
+    , begin_ptr_(begin_.get_localto(this))
+    , end_ptr_(end_.get_localto(this))
+    , bounds_ptr_(bounds_.get_localto(this))
+    {
+        // Deal out the items
+        std::vector<long> pos(NODELETS(), 0);
+        long * pos_ptr = pos.data();
+        g.for_each_vertex(emu::fixed, [this, &g, grain, pos_ptr](long v) {
+            edge_iterator edges_end = g.out_edges_end(v);
+            long nlet = v & (NODELETS() - 1);
+            for (edge_iterator e1 = g.out_edges_begin(v); e1 < edges_end;
+                 e1 += grain) {
+                edge_iterator e2 = e1 + grain;
+                if (e2 > edges_end) { e2 = edges_end; }
+                long i = emu::atomic_addms(&pos_ptr[nlet], 1);
+                src_.get_nth(nlet)[i] = v;
+                begin_.get_nth(nlet)[i] = e1;
+                end_.get_nth(nlet)[i] = e2;
+                nlet = (nlet + 1) & (NODELETS() - 1);
+            }
+        });
+
+        // Cut the items on each nodelet into chunks with equal edge counts
+        for (long nlet = 0; nlet < NODELETS(); ++nlet) {
+            edge_iterator * begin = begin_.get_nth(nlet);
+            edge_iterator * end = end_.get_nth(nlet);
+            long * bounds = bounds_.get_nth(nlet);
+            long count = pos[nlet];
+            long total = 0;
+            for (long i = 0; i < count; ++i) { total += end[i] - begin[i]; }
+            long c = 0;
+            long edges = 0;
+            bounds[0] = 0;
+            for (long i = 0; i < count && c + 1 < num_chunks_; ++i) {
+                edges += end[i] - begin[i];
+                // Chunk c ends once it has its share of the edges
+                if (edges * num_chunks_ >= total * (c + 1)) {
+                    bounds[++c] = i + 1;
+                }
+            }
+            // Remaining chunks get whatever is left, possibly nothing
+            while (c < num_chunks_) { bounds[++c] = count; }
+        }
+    }
+
+    // Shallow copy constructor
+    edge_schedule(const edge_schedule& other, emu::shallow_copy shallow)
+    : num_chunks_(other.num_chunks_)
+    , src_(other.src_, shallow)
+    , begin_(other.begin_, shallow)
+    , end_(other.end_, shallow)
+    , bounds_(other.bounds_, shallow)
+    , src_ptr_(src_.get_localto(this))
+    , begin_ptr_(begin_.get_localto(this))
+    , end_ptr_(end_.get_localto(this))
+    , bounds_ptr_(bounds_.get_localto(this))
+    {}
+
+    /**
+     * Visit every edge in the graph, spawning one thread per chunk on each
+     * nodelet.
+     * Only valid to call on a replicated instance
+     * @param visitor Lambda function to call on each range of edges, with
+     * signature: @c void (long src, edge_iterator begin, edge_iterator end)
+     */
+    template<class Visitor>
+    void process_all_ranges(Visitor visitor)
+    {
+        assert(emu::pmanip::is_repl(this));
+        emu::repl_for_each(emu::parallel_policy<1>(), *this,
+            [visitor](edge_schedule & s) {
+                for (long c = 0; c < s.num_chunks_; ++c) {
+                    cilk_spawn s.process_chunk(c, visitor);
+                }
+            }
+        );
+    }
+};
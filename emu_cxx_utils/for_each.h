@@ -152,13 +152,16 @@ private:
     void worker_thread_1()
     {
         long increment = nlet_stride ? NODELETS() : 1;
+        // Every spawned thread calls this on the same dyn_worker, so make a
+        // private copy of the functor in case it has state (i.e. reducers)
+        UnaryOp unary_op = unary_op_;
         // Atomically grab items off the list
         for (T* next = atomic_addms(next_ptr_, increment);
              next < end_;
              next = atomic_addms(next_ptr_, increment))
         {
             // Process each element
-            unary_op_(*next);
+            unary_op(*next);
         }
     }
 
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <emu_cxx_utils/replicated.h>
+#include <emu_cxx_utils/striped_array.h>
+#include <emu_cxx_utils/for_each.h>
+#include <emu_cxx_utils/fill.h>
+#include <emu_cxx_utils/intrinsics.h>
+#include "chunked_queue.h"
+
+/**
+ * Dense representation of a BFS frontier, with one bit per vertex.
+ *
+ * The bits are laid out in a striped array so that the bit for vertex v is
+ * stored on the same nodelet as v, just like the items in chunked_queue.
+ * Converting between the two representations never leaves the nodelet.
+ *
+ * There are two planes of bits: the current frontier, which is only read
+ * during a step, and the next frontier, which is written. advance() makes the
+ * next frontier current.
+ */
+class frontier_bitmap
+{
+private:
+    // Number of words in each plane, a multiple of NODELETS()
+    long words_per_plane_;
+    // Storage for both planes
+    emu::striped_array<unsigned long> words_;
+    // Offset of the current plane (0 or words_per_plane_)
+    emu::repl<long> current_;
+
+    static long
+    words_per_plane(long num_vertices)
+    {
+        long vertices_per_nodelet = (num_vertices + NODELETS() - 1) / NODELETS();
+        return ((vertices_per_nodelet + 63) / 64) * NODELETS();
+    }
+
+    // Index of the word holding the bit for vertex v, within a plane
+    static long
+    word_index(long v)
+    {
+        return (v / NODELETS() / 64) * NODELETS() + (v & (NODELETS() - 1));
+    }
+
+    static unsigned long
+    bit_mask(long v)
+    {
+        return 1UL << ((v / NODELETS()) % 64);
+    }
+
+    long next_offset() const { return words_per_plane_ - current_; }
+
+    void
+    clear_plane(long offset)
+    {
+        auto begin = words_.begin() + offset;
+        emu::parallel::fill(begin, begin + words_per_plane_, 0UL);
+    }
+
+    /**
+     * Call worker(v) for every vertex with a bit set in the plane at offset,
+     * and clear the bits first if requested. Threads scan the words on their
+     * own nodelet, and words that are zero are skipped with a single load.
+     */
+    template<class Function>
+    void
+    scan_plane(long offset, bool clear, Function worker)
+    {
+        auto begin = words_.begin() + offset;
+        emu::parallel::for_each(emu::fixed, begin, begin + words_per_plane_,
+            [begin, clear, worker](unsigned long & word) mutable {
+                if (word == 0) { return; }
+                unsigned long bits = word;
+                if (clear) { word = 0; }
+                long w = &word - begin;
+                // Recover the vertex ID from the position of each set bit
+                long nlet = w & (NODELETS() - 1);
+                long base = (w / NODELETS()) * 64;
+                for (; bits != 0; bits &= bits - 1) {
+                    long b = __builtin_ctzl(bits);
+                    worker((base + b) * NODELETS() + nlet);
+                }
+            }
+        );
+    }
+
+public:
+    explicit frontier_bitmap(long num_vertices)
+    : words_per_plane_(words_per_plane(num_vertices))
+    , words_(2 * words_per_plane_)
+    , current_(0)
+    {
+        clear_plane(0);
+        clear_plane(words_per_plane_);
+    }
+
+    // Shallow copy constructor
+    frontier_bitmap(const frontier_bitmap& other, emu::shallow_copy shallow)
+    : words_per_plane_(other.words_per_plane_)
+    , words_(other.words_, shallow)
+    , current_(other.current_)
+    {}
+
+    // Is v in the current frontier?
+    bool
+    get(long v)
+    {
+        return words_[current_ + word_index(v)] & bit_mask(v);
+    }
+
+    // Add v to the next frontier
+    void
+    set_next(long v)
+    {
+        emu::remote_or(&words_[next_offset() + word_index(v)], bit_mask(v));
+    }
+
+    // Empty the next frontier
+    void
+    clear_next()
+    {
+        clear_plane(next_offset());
+    }
+
+    // Make the next frontier current
+    void
+    advance()
+    {
+        current_ = next_offset();
+    }
+
+    /**
+     * Replace the current frontier with the current window of the queue.
+     * Each nodelet sets bits for the vertices in its own queue.
+     */
+    void
+    from_queue(chunked_queue & queue)
+    {
+        clear_plane(current_);
+        long offset = current_;
+        queue.forall_items([this, offset](long v) {
+            emu::remote_or(&words_[offset + word_index(v)], bit_mask(v));
+        });
+    }
+
+    /**
+     * Push every vertex in the current frontier onto the queue.
+     * Threads scan the words on their own nodelet, so every push is local.
+     * The caller must call slide_all_windows() to make them visible.
+     */
+    void
+    to_queue(chunked_queue & queue)
+    {
+        scan_plane(current_, false,
+            [push=queue.make_pusher()](long v) mutable { push(v); });
+    }
+
+    /**
+     * Call worker(v) for every vertex in the next frontier, removing it.
+     * Leaves the next frontier empty without another pass over the words.
+     */
+    template<class Function>
+    void
+    drain_next(Function worker)
+    {
+        scan_plane(next_offset(), true, worker);
+    }
+};
@@ -26,7 +26,7 @@ struct rmat_args
     static rmat_args
     from_string(const std::string& str)
     {
-        rmat_args args;
+        rmat_args args = {};
         std::smatch m;
 
         std::regex r1(R"((\d+[.]\d+)-(\d+[.]\d+)-(\d+[.]\d+)-(\d+[.]\d+)-(\d+[KMGT]?)-(\d+[KMGT]?)\.rmat)");
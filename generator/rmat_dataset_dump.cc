@@ -1,9 +1,12 @@
 #include <iostream>
 #include <algorithm>
+#include <cstring>
 
 #include "pvector.h"
 #include "rmat_args.h"
 #include "rmat_generator.h"
+#include "synthetic_args.h"
+#include "synthetic_generators.h"
 #include "edge_list_utils.h"
 
 using std::cerr;
@@ -15,35 +18,38 @@ print_help_and_quit()
     cerr << "    Format 1: A-B-C-D-edges-vertices.rmat\n";
     cerr << "    Format 2: graph500-scaleN\n";
     cerr << "    Format 3: graph500-scaleN.mtx\n";
+    cerr << "    Format 4: edges-vertices.er            (Erdos-Renyi)\n";
+    cerr << "    Format 5: X-Y-Z-P.grid                 (2D/3D grid with shortcut probability P)\n";
+    cerr << "    Format 6: B-F-edges-vertices.sbm       (B blocks, fraction F of edges within a block)\n";
+    cerr << "    Format 7: G-edges-vertices.cl          (Chung-Lu with power-law exponent G)\n";
+    cerr << "    Format 8: D-vertices.ba                (Barabasi-Albert with D edges per vertex)\n";
+    cerr << "    Append .mtx to any format to write Matrix Market instead of binary\n";
     exit(1);
 }
 
-int
-main(int argc, const char* argv[])
+template<class Args>
+void
+check_args(const Args& args)
 {
-    if (argc != 2) { print_help_and_quit(); }
-
-    std::string filename = argv[1];
-
-    // Parse rmat arguments
-    rmat_args args = rmat_args::from_string(argv[1]);
     std::string error = args.validate();
     if (!error.empty())
     {
         cerr << error << "\n";
         print_help_and_quit();
     }
+}
 
-    // Init RMAT edge generator
-    rmat_edge_generator
-    generator(args.num_vertices, args.a, args.b, args.c, args.d);
-
-    cerr << "Generating list of " << args.num_edges << " edges...\n";
+template<class Generator>
+void
+generate_and_dump(const std::string& filename, Generator& generator,
+    int64_t num_edges, int64_t num_vertices)
+{
+    cerr << "Generating list of " << num_edges << " edges...\n";
     // Allocate edge list
-    pvector<edge> edges(args.num_edges);
+    pvector<edge> edges(num_edges);
 
     // Fill with randomly generated edges
-    rmat_fill(generator, edges.begin(), edges.end());
+    parallel_edge_fill(generator, edges.begin(), edges.end());
     // Make all edges point from lower to higher vertex ID
     flip_edges(edges.begin(), edges.end());
     // Sort edges in ascending order
@@ -52,15 +58,60 @@ main(int argc, const char* argv[])
     auto new_end = dedup_edges(edges.begin(), edges.end());
     edges.resize(new_end - edges.begin());
     // Randomly remap vertex ID's
-    remap_vertex_ids(args.num_vertices, edges.begin(), edges.end());
+    remap_vertex_ids(num_vertices, edges.begin(), edges.end());
     // Shuffle edges randomly
     std::random_shuffle(edges.begin(), edges.end());
 
     cerr << "Writing to file...\n";
-    if (!strcmp(".mtx", &*filename.end() - 4)) {
-        dump_mm(filename, args.num_vertices, edges.begin(), edges.end());
+    if (filename.size() >= 4 && !strcmp(".mtx", &*filename.end() - 4)) {
+        dump_mm(filename, num_vertices, edges.begin(), edges.end());
     } else {
-        dump_bin(filename, args.num_vertices, edges.begin(), edges.end());
+        dump_bin(filename, num_vertices, edges.begin(), edges.end());
     }
     cerr << "...Done\n";
-}
\ No newline at end of file
+}
+
+int
+main(int argc, const char* argv[])
+{
+    if (argc != 2) { print_help_and_quit(); }
+
+    std::string filename = argv[1];
+
+    erdos_renyi_args er;
+    grid_args grid;
+    sbm_args sbm;
+    chung_lu_args cl;
+    barabasi_albert_args ba;
+
+    if (erdos_renyi_args::parse(filename, er)) {
+        check_args(er);
+        erdos_renyi_edge_generator generator(er.num_vertices);
+        generate_and_dump(filename, generator, er.num_edges, er.num_vertices);
+    } else if (grid_args::parse(filename, grid)) {
+        check_args(grid);
+        grid_edge_generator generator(grid.x, grid.y, grid.z, grid.p);
+        generate_and_dump(filename, generator,
+            generator.num_lattice_edges(), grid.num_vertices());
+    } else if (sbm_args::parse(filename, sbm)) {
+        check_args(sbm);
+        sbm_edge_generator generator(sbm.num_vertices, sbm.num_blocks, sbm.f);
+        generate_and_dump(filename, generator, sbm.num_edges, sbm.num_vertices);
+    } else if (chung_lu_args::parse(filename, cl)) {
+        check_args(cl);
+        chung_lu_edge_generator generator(cl.num_vertices, cl.gamma);
+        generate_and_dump(filename, generator, cl.num_edges, cl.num_vertices);
+    } else if (barabasi_albert_args::parse(filename, ba)) {
+        check_args(ba);
+        barabasi_albert_edge_generator generator(ba.num_vertices, ba.d);
+        generate_and_dump(filename, generator, ba.num_edges(), ba.num_vertices);
+    } else {
+        // Parse rmat arguments
+        rmat_args args = rmat_args::from_string(filename);
+        check_args(args);
+        // Init RMAT edge generator
+        rmat_edge_generator
+        generator(args.num_vertices, args.a, args.b, args.c, args.d);
+        generate_and_dump(filename, generator, args.num_edges, args.num_vertices);
+    }
+}
@@ -138,16 +138,23 @@ public:
         *src = i;
         *dst = j;
     }
+
+    // Replaces a self edge with the next random edge
+    void reroll_edge(int64_t *src, int64_t *dst)
+    {
+        next_edge(src, dst);
+    }
 };
 
 // Fill up an array with randomly generated edges
-template<class Iterator>
+// Works with any generator that implements discard(), next_edge() and reroll_edge()
+template<class Generator, class Iterator>
 void
-rmat_fill(rmat_edge_generator& generator, Iterator edges_begin, Iterator edges_end)
+parallel_edge_fill(Generator& generator, Iterator edges_begin, Iterator edges_end)
 {
     using Edge = typename std::iterator_traits<Iterator>::value_type;
     // Make a local copy of the edge generator
-    rmat_edge_generator local_rng = generator;
+    Generator local_rng = generator;
 
     // Keeps track of this thread's position in the random number stream relative to the loop index
     int64_t pos = 0;
@@ -184,10 +191,18 @@ rmat_fill(rmat_edge_generator& generator, Iterator edges_begin, Iterator edges_e
     {
         Edge& e = edges_begin[i];
         while (e.src == e.dst) {
-            local_rng.next_edge(&e.src, &e.dst);
+            local_rng.reroll_edge(&e.src, &e.dst);
         }
     }
 
     // Copy final RNG state back to caller
     generator = local_rng;
 }
+
+// Fill up an array with RMAT edges
+template<class Iterator>
+void
+rmat_fill(rmat_edge_generator& generator, Iterator edges_begin, Iterator edges_end)
+{
+    parallel_edge_fill(generator, edges_begin, edges_end);
+}
@@ -0,0 +1,175 @@
+#pragma once
+#include <cinttypes>
+#include <sstream>
+#include <regex>
+#include "rmat_args.h"
+
+/*
+ * Argument parsers for the generators in synthetic_generators.h
+ * Each generator is selected by file extension, and its parameters are
+ * encoded in the file name with the same A-B-...-num_edges-num_vertices
+ * convention used by rmat_args.
+ * parse() returns false if the string does not match the expected format.
+ */
+
+// num_edges-num_vertices.er
+struct erdos_renyi_args
+{
+    int64_t num_edges, num_vertices;
+
+    static bool
+    parse(const std::string& str, erdos_renyi_args& args)
+    {
+        std::smatch m;
+        std::regex r(R"((\d+[KMGT]?)-(\d+[KMGT]?)\.er(\.mtx)?)");
+        if (!std::regex_match(str, m, r)) { return false; }
+        args.num_edges = rmat_args::parse_int_with_suffix(m[1]);
+        args.num_vertices = rmat_args::parse_int_with_suffix(m[2]);
+        return true;
+    }
+
+    std::string
+    validate() const {
+        std::ostringstream oss;
+        if (num_edges <= 0 || num_vertices <= 0) {
+            oss << "Invalid arguments: graph must have a positive number of edges and vertices\n";
+        } else if (num_vertices < 2) {
+            oss << "Invalid arguments: need at least two vertices to avoid self edges\n";
+        }
+        return oss.str();
+    }
+};
+
+// X-Y-Z-P.grid: X*Y*Z vertices (use Z=1 for a 2D grid), rewiring probability P
+struct grid_args
+{
+    int64_t x, y, z;
+    double p;
+
+    static bool
+    parse(const std::string& str, grid_args& args)
+    {
+        std::smatch m;
+        std::regex r(R"((\d+[KMGT]?)-(\d+[KMGT]?)-(\d+[KMGT]?)-(\d+[.]\d+)\.grid(\.mtx)?)");
+        if (!std::regex_match(str, m, r)) { return false; }
+        args.x = rmat_args::parse_int_with_suffix(m[1]);
+        args.y = rmat_args::parse_int_with_suffix(m[2]);
+        args.z = rmat_args::parse_int_with_suffix(m[3]);
+        args.p = std::stod(m[4]);
+        return true;
+    }
+
+    int64_t num_vertices() const { return x * y * z; }
+
+    std::string
+    validate() const {
+        std::ostringstream oss;
+        if (x <= 0 || y <= 0 || z <= 0) {
+            oss << "Invalid arguments: grid dimensions must be positive\n";
+        } else if (num_vertices() < 2) {
+            oss << "Invalid arguments: need at least two vertices to avoid self edges\n";
+        } else if (p < 0 || p > 1) {
+            oss << "Invalid arguments: rewiring probability must fall in the range [0, 1]\n";
+        }
+        return oss.str();
+    }
+};
+
+// B-F-num_edges-num_vertices.sbm: B blocks, fraction F of edges within a block
+struct sbm_args
+{
+    int64_t num_blocks;
+    double f;
+    int64_t num_edges, num_vertices;
+
+    static bool
+    parse(const std::string& str, sbm_args& args)
+    {
+        std::smatch m;
+        std::regex r(R"((\d+[KMGT]?)-(\d+[.]\d+)-(\d+[KMGT]?)-(\d+[KMGT]?)\.sbm(\.mtx)?)");
+        if (!std::regex_match(str, m, r)) { return false; }
+        args.num_blocks = rmat_args::parse_int_with_suffix(m[1]);
+        args.f = std::stod(m[2]);
+        args.num_edges = rmat_args::parse_int_with_suffix(m[3]);
+        args.num_vertices = rmat_args::parse_int_with_suffix(m[4]);
+        return true;
+    }
+
+    std::string
+    validate() const {
+        std::ostringstream oss;
+        if (num_edges <= 0 || num_vertices <= 0) {
+            oss << "Invalid arguments: graph must have a positive number of edges and vertices\n";
+        } else if (num_blocks <= 0 || num_blocks > num_vertices) {
+            oss << "Invalid arguments: number of blocks must fall in the range [1, num_vertices]\n";
+        } else if (f < 0 || f > 1) {
+            oss << "Invalid arguments: intra-block fraction must fall in the range [0, 1]\n";
+        } else if (num_vertices < 2) {
+            oss << "Invalid arguments: need at least two vertices to avoid self edges\n";
+        } else if (f == 1 && num_blocks == num_vertices) {
+            oss << "Invalid arguments: blocks of one vertex with an intra-block fraction of 1 only have self edges\n";
+        }
+        return oss.str();
+    }
+};
+
+// G-num_edges-num_vertices.cl: Chung-Lu with power-law exponent G
+struct chung_lu_args
+{
+    double gamma;
+    int64_t num_edges, num_vertices;
+
+    static bool
+    parse(const std::string& str, chung_lu_args& args)
+    {
+        std::smatch m;
+        std::regex r(R"((\d+[.]\d+)-(\d+[KMGT]?)-(\d+[KMGT]?)\.cl(\.mtx)?)");
+        if (!std::regex_match(str, m, r)) { return false; }
+        args.gamma = std::stod(m[1]);
+        args.num_edges = rmat_args::parse_int_with_suffix(m[2]);
+        args.num_vertices = rmat_args::parse_int_with_suffix(m[3]);
+        return true;
+    }
+
+    std::string
+    validate() const {
+        std::ostringstream oss;
+        if (num_edges <= 0 || num_vertices <= 0) {
+            oss << "Invalid arguments: graph must have a positive number of edges and vertices\n";
+        } else if (gamma <= 2) {
+            oss << "Invalid arguments: power-law exponent must be greater than 2\n";
+        } else if (num_vertices < 2) {
+            oss << "Invalid arguments: need at least two vertices to avoid self edges\n";
+        }
+        return oss.str();
+    }
+};
+
+// D-num_vertices.ba: Barabási–Albert with D edges per vertex
+struct barabasi_albert_args
+{
+    int64_t d;
+    int64_t num_vertices;
+
+    static bool
+    parse(const std::string& str, barabasi_albert_args& args)
+    {
+        std::smatch m;
+        std::regex r(R"((\d+)-(\d+[KMGT]?)\.ba(\.mtx)?)");
+        if (!std::regex_match(str, m, r)) { return false; }
+        args.d = rmat_args::parse_int_with_suffix(m[1]);
+        args.num_vertices = rmat_args::parse_int_with_suffix(m[2]);
+        return true;
+    }
+
+    int64_t num_edges() const { return d * num_vertices; }
+
+    std::string
+    validate() const {
+        std::ostringstream oss;
+        if (d <= 0 || num_vertices <= 1) {
+            oss << "Invalid arguments: need at least one edge per vertex and two vertices\n";
+        }
+        return oss.str();
+    }
+};
@@ -0,0 +1,344 @@
+#pragma once
+#include <cassert>
+#include <cinttypes>
+#include <cmath>
+#include <algorithm>
+#include "prng_engine.hpp"
+
+/*
+ * Non-RMAT edge generators, for benchmarking on graphs with a different
+ * topology than graph500 (meshes, community structure, etc.)
+ *
+ * Like rmat_edge_generator, each of these implements discard() to skip ahead
+ * in the random stream in constant time, so they can be used with
+ * parallel_edge_fill(), and reroll_edge() to replace the self edges it finds.
+ */
+
+/*
+ * Wrapper around sitmo::prng_engine that always consumes exactly two 32-bit
+ * values from the engine for each number generated. This makes it trivial to
+ * compute how far to advance the engine in discard().
+ */
+class seekable_rng {
+private:
+    sitmo::prng_engine engine_;
+public:
+    explicit seekable_rng(uint32_t seed) : engine_(seed) {}
+
+    // Returns a uniformly distributed 64-bit integer
+    uint64_t next_u64()
+    {
+        uint64_t hi = engine_();
+        uint64_t lo = engine_();
+        return (hi << 32) | lo;
+    }
+
+    // Returns a uniformly distributed integer in the range [0, n)
+    int64_t next_index(int64_t n)
+    {
+        assert(n > 0);
+        // Multiply-high avoids the bias and the division of a modulo
+        return static_cast<int64_t>(
+            (static_cast<__uint128_t>(next_u64()) * static_cast<uint64_t>(n)) >> 64);
+    }
+
+    // Returns a uniformly distributed double in the range [0, 1)
+    double next_double()
+    {
+        // Use the upper 53 bits to fill the mantissa
+        return (next_u64() >> 11) * (1.0 / (1ULL << 53));
+    }
+
+    // Skips past the next n numbers generated by any of the next_* functions
+    void discard(uint64_t n)
+    {
+        engine_.discard(2 * n);
+    }
+};
+
+/*
+ * Erdős–Rényi G(n, m) edge generator
+ * Both endpoints of each edge are chosen uniformly at random
+ */
+class erdos_renyi_edge_generator {
+private:
+    seekable_rng rng_;
+    int64_t num_vertices_;
+public:
+    erdos_renyi_edge_generator(int64_t nv, uint32_t seed=0)
+    : rng_(seed)
+    , num_vertices_(nv)
+    {}
+
+    // Skips past the next n randomly generated edges
+    void discard(uint64_t n)
+    {
+        // Two random numbers per edge
+        rng_.discard(n * 2);
+    }
+
+    void next_edge(int64_t *src, int64_t *dst)
+    {
+        *src = rng_.next_index(num_vertices_);
+        *dst = rng_.next_index(num_vertices_);
+    }
+
+    // Replaces a self edge with the next random edge
+    void reroll_edge(int64_t *src, int64_t *dst)
+    {
+        next_edge(src, dst);
+    }
+};
+
+/*
+ * 2D/3D grid (torus) with random shortcuts
+ * The Nth edge connects vertex N/dims to its neighbor in dimension N%dims.
+ * With probability p, the far endpoint is replaced with a vertex chosen
+ * uniformly at random (Watts-Strogatz style rewiring). With p=0 this models
+ * a road-like mesh with very high diameter.
+ */
+class grid_edge_generator {
+private:
+    seekable_rng rng_;
+    // Length of each side of the grid
+    int64_t sides_[3];
+    // Number of dimensions with length > 1
+    int64_t dims_[3];
+    int64_t num_dims_;
+    int64_t num_vertices_;
+    // Probability that an edge is rewired to a random vertex
+    double p_;
+    // Index of the next edge to generate
+    uint64_t pos_;
+public:
+    grid_edge_generator(int64_t x, int64_t y, int64_t z, double p, uint32_t seed=0)
+    : rng_(seed)
+    , sides_{x, y, z}
+    , dims_{0, 0, 0}
+    , num_dims_(0)
+    , num_vertices_(x * y * z)
+    , p_(p)
+    , pos_(0)
+    {
+        for (int64_t d = 0; d < 3; ++d) {
+            if (sides_[d] > 1) { dims_[num_dims_++] = d; }
+        }
+        // A 1x1x1 grid only has self edges, grid_args::validate() rejects it
+        if (num_dims_ == 0) { dims_[num_dims_++] = 0; }
+    }
+
+    // Number of edges in the grid before any are rewired
+    int64_t num_lattice_edges() const { return num_vertices_ * num_dims_; }
+
+    // Skips past the next n randomly generated edges
+    void discard(uint64_t n)
+    {
+        // Three random numbers per edge, whether it gets rewired or not
+        rng_.discard(n * 3);
+        pos_ += n;
+    }
+
+    void next_edge(int64_t *src, int64_t *dst)
+    {
+        uint64_t i = pos_++;
+        // Always consume the same number of random values
+        double r = rng_.next_double();
+        int64_t random_dst = rng_.next_index(num_vertices_);
+        (void)rng_.next_u64();
+
+        // Keep generating edges after the last lattice edge (i.e. re-rolling
+        // self-edges) by wrapping around
+        int64_t v = (i / num_dims_) % num_vertices_;
+        *src = v;
+        if (r < p_) {
+            *dst = random_dst;
+            return;
+        }
+        // Decompose vertex ID into coordinates
+        int64_t coord[3] = {
+            v % sides_[0],
+            (v / sides_[0]) % sides_[1],
+            v / (sides_[0] * sides_[1])
+        };
+        // Step to the neighbor in the selected dimension, wrapping around
+        int64_t d = dims_[i % num_dims_];
+        coord[d] = (coord[d] + 1) % sides_[d];
+        *dst = coord[0] + sides_[0] * (coord[1] + sides_[1] * coord[2]);
+    }
+
+    // Replaces a self edge with the next random edge
+    void reroll_edge(int64_t *src, int64_t *dst)
+    {
+        next_edge(src, dst);
+    }
+};
+
+/*
+ * Stochastic block model (planted partition variant)
+ * Vertices are divided into equal-sized blocks of consecutive IDs. The source
+ * of each edge is uniform; with probability f the destination is chosen from
+ * the same block, otherwise it is chosen uniformly from the whole graph.
+ */
+class sbm_edge_generator {
+private:
+    seekable_rng rng_;
+    int64_t num_vertices_;
+    int64_t block_size_;
+    // Fraction of edges that stay within a block
+    double f_;
+public:
+    sbm_edge_generator(int64_t nv, int64_t num_blocks, double f, uint32_t seed=0)
+    : rng_(seed)
+    , num_vertices_(nv)
+    , block_size_((nv + num_blocks - 1) / num_blocks)
+    , f_(f)
+    {}
+
+    // Skips past the next n randomly generated edges
+    void discard(uint64_t n)
+    {
+        // Three random numbers per edge
+        rng_.discard(n * 3);
+    }
+
+    void next_edge(int64_t *src, int64_t *dst)
+    {
+        *src = rng_.next_index(num_vertices_);
+        double r = rng_.next_double();
+        uint64_t x = rng_.next_u64();
+        if (r < f_) {
+            // Pick a vertex from the same block
+            int64_t block_begin = (*src / block_size_) * block_size_;
+            int64_t block_end = std::min(block_begin + block_size_, num_vertices_);
+            int64_t n = block_end - block_begin;
+            *dst = block_begin + static_cast<int64_t>(
+                (static_cast<__uint128_t>(x) * static_cast<uint64_t>(n)) >> 64);
+        } else {
+            // Pick any vertex
+            *dst = static_cast<int64_t>(
+                (static_cast<__uint128_t>(x) * static_cast<uint64_t>(num_vertices_)) >> 64);
+        }
+    }
+
+    // Replaces a self edge with the next random edge
+    void reroll_edge(int64_t *src, int64_t *dst)
+    {
+        next_edge(src, dst);
+    }
+};
+
+/*
+ * Chung-Lu edge generator with power-law expected degrees
+ * Vertex i has weight proportional to (i+1)^(-1/(gamma-1)), which gives a
+ * degree distribution with exponent gamma. Each endpoint is drawn with
+ * probability proportional to its weight, using the closed-form inverse of the
+ * (continuous) CDF so that each endpoint costs O(1).
+ */
+class chung_lu_edge_generator {
+private:
+    seekable_rng rng_;
+    int64_t num_vertices_;
+    // Exponent applied to a uniform random number to get a vertex position
+    double exponent_;
+
+    int64_t next_endpoint()
+    {
+        double u = rng_.next_double();
+        auto v = static_cast<int64_t>(num_vertices_ * std::pow(u, exponent_));
+        return std::min(v, num_vertices_ - 1);
+    }
+public:
+    chung_lu_edge_generator(int64_t nv, double gamma, uint32_t seed=0)
+    : rng_(seed)
+    , num_vertices_(nv)
+    // CDF is (x/n)^(1-a), where a = 1/(gamma-1)
+    , exponent_(1.0 / (1.0 - 1.0 / (gamma - 1.0)))
+    {}
+
+    // Skips past the next n randomly generated edges
+    void discard(uint64_t n)
+    {
+        // Two random numbers per edge
+        rng_.discard(n * 2);
+    }
+
+    void next_edge(int64_t *src, int64_t *dst)
+    {
+        *src = next_endpoint();
+        *dst = next_endpoint();
+    }
+
+    // Replaces a self edge with the next random edge
+    void reroll_edge(int64_t *src, int64_t *dst)
+    {
+        next_edge(src, dst);
+    }
+};
+
+/*
+ * Barabási–Albert preferential attachment
+ * Vertex v brings d edges into the graph. Uses the copy model formulation of
+ * Sanders and Schulz: the target of edge i is a copy of a uniformly random
+ * earlier entry in the (implicit) array of edge endpoints. Since the random
+ * number for each edge is a pure function of the edge index, any edge can be
+ * regenerated independently, which allows skipping ahead in constant time.
+ */
+class barabasi_albert_edge_generator {
+private:
+    // RNG state before generating the first edge
+    seekable_rng base_rng_;
+    int64_t num_vertices_;
+    // Number of edges added with each vertex
+    int64_t d_;
+    // Index of the next edge to generate
+    uint64_t pos_;
+
+    // Source of the ith edge
+    int64_t source(uint64_t i) const
+    {
+        return static_cast<int64_t>((i / d_) % num_vertices_);
+    }
+
+    // Target of the ith edge
+    int64_t target(uint64_t i) const
+    {
+        for (;;) {
+            // Get the random number for this edge
+            seekable_rng rng = base_rng_;
+            rng.discard(i);
+            // Pick one of the 2i+1 endpoints generated before this one
+            uint64_t r = rng.next_index(2 * i + 1);
+            // Even positions are sources, which we can compute directly
+            if (r % 2 == 0) { return source(r / 2); }
+            // Odd positions are targets of an earlier edge, keep going
+            i = r / 2;
+        }
+    }
+public:
+    barabasi_albert_edge_generator(int64_t nv, int64_t d, uint32_t seed=0)
+    : base_rng_(seed)
+    , num_vertices_(nv)
+    , d_(d)
+    , pos_(0)
+    {}
+
+    // Skips past the next n randomly generated edges
+    void discard(uint64_t n)
+    {
+        pos_ += n;
+    }
+
+    void next_edge(int64_t *src, int64_t *dst)
+    {
+        uint64_t i = pos_++;
+        *src = source(i);
+        *dst = target(i);
+    }
+
+    // Replaces the target of a self edge, keeping the source so that each
+    // vertex still brings d edges into the graph
+    void reroll_edge(int64_t * /* src */, int64_t *dst)
+    {
+        *dst = target(pos_++);
+    }
+};
@@ -1,20 +1,33 @@
 #include "hybrid_bfs.h"
 #include "ack_control.h"
 
+#include <climits>
+#include <algorithm>
+
 #include <emu_cxx_utils/execution_policy.h>
 #include <emu_cxx_utils/for_each.h>
 #include <emu_cxx_utils/find.h>
 
 using namespace emu;
 
-hybrid_bfs::hybrid_bfs(graph & g)
+hybrid_bfs::hybrid_bfs(graph & g, bool sparse_levels)
 : g_(&g)
 , parent_(g.num_vertices())
 , new_parent_(g.num_vertices())
 , queue_(g.num_vertices())
+, reverse_queue_(g.num_vertices())
+, meet_(-1L)
+, frontier_(g.num_vertices())
+, sparse_levels_(sparse_levels)
+// Only allocate a full-size log if it will be used
+, touched_(sparse_levels ? g.num_vertices() : 1)
+, depth_(g.num_vertices())
+, async_queue_(g.num_vertices())
 , scout_count_(0L)
 , awake_count_(0L)
 , worklist_(g.num_vertices())
+, costs_{0, 0, 0, 0, 0, 0}
+, needs_full_clear_(true)
 {
     // Force ack controller singleton to initialize itself
     ack_control_init();
@@ -26,9 +39,18 @@ hybrid_bfs::hybrid_bfs(const hybrid_bfs& other, emu::shallow_copy shallow)
 , parent_(other.parent_, shallow)
 , new_parent_(other.new_parent_, shallow)
 , queue_(other.queue_, shallow)
+, reverse_queue_(other.reverse_queue_, shallow)
+, meet_(other.meet_)
+, frontier_(other.frontier_, shallow)
+, sparse_levels_(other.sparse_levels_)
+, touched_(other.touched_, shallow)
+, depth_(other.depth_, shallow)
+, async_queue_(other.async_queue_, shallow)
 , scout_count_(other.scout_count_)
 , awake_count_(other.awake_count_)
 , worklist_(other.worklist_, shallow)
+, costs_(other.costs_)
+, needs_full_clear_(other.needs_full_clear_)
 {}
 
 /**
@@ -37,6 +59,12 @@ hybrid_bfs::hybrid_bfs(const hybrid_bfs& other, emu::shallow_copy shallow)
  * If the dst vertex doesn't have a parent, set src as parent
  * Then append to local queue for next frontier
  * Return the sum of the degrees of the vertices in the new frontier
+ *
+ * With sparse_levels_ set, each write also sets the destination's bit in
+ * touched_ (another remote write), and only the touched vertices are
+ * checked afterwards. This replaces a pass over every vertex with a pass
+ * over the words of the log, which is much cheaper on graphs with many
+ * small levels.
  */
 long
 hybrid_bfs::top_down_step_with_remote_writes()
@@ -48,22 +76,29 @@ hybrid_bfs::top_down_step_with_remote_writes()
         g_->for_each_out_edge(src, [&](long dst) {
             // write the vertex ID to the neighbor's new_parent entry.
             new_parent_[dst] = src; // Remote write
+            if (sparse_levels_) { touched_.set_next(dst); }
         });
     });
     ack_control_reenable_acks();
 
     // Add to the queue all vertices that didn't have a parent before
     scout_count_ = 0;
-    g_->for_each_vertex([&](long v) {
+    auto visit = [this, push=queue_.make_pusher()](long v) mutable {
         if (parent_[v] < 0 && new_parent_[v] >= 0) {
             // Update count with degree of new vertex
             REMOTE_ADD(&scout_count_, -parent_[v]);
             // Set parent
             parent_[v] = new_parent_[v];
             // Add to the queue for the next frontier
-            queue_.push_back(v);
+            push(v);
         }
-    });
+    };
+    if (sparse_levels_) {
+        // Only look at the vertices we wrote to, and clear the log
+        touched_.drain_next(visit);
+    } else {
+        g_->for_each_vertex(visit);
+    }
     // Combine per-nodelet values of scout_count
     return emu::repl_reduce(scout_count_, std::plus<>());
 }
@@ -75,12 +110,13 @@ hybrid_bfs::top_down_step_with_migrating_threads()
     // For each neighbor without a parent, add self as parent and append to queue
     scout_count_ = 0;
     worklist_.clear_all();
-    queue_.forall_items([this](long src) {
-        worklist_.append(src, g_->out_edges_begin(src), g_->out_edges_end(src));
+    queue_.forall_items(
+        [this, append=worklist_.make_appender()](long src) mutable {
+        append(src, g_->out_edges_begin(src), g_->out_edges_end(src));
     });
 
     worklist_.process_all_edges(dynamic_unroll_policy<64>(),
-        [this](long src, long dst) {
+        [this, push=queue_.make_pusher()](long src, long dst) mutable {
             // Look up the parent of the vertex we are visiting
             long * parent = &parent_[dst];
             long curr_val = *parent;
@@ -89,7 +125,7 @@ hybrid_bfs::top_down_step_with_migrating_threads()
                 // Set self as parent of this vertex
                 if (atomic_cas(parent, curr_val, src) == curr_val) {
                     // Add it to the queue
-                    queue_.push_back(dst);
+                    push(dst);
                     remote_add(&scout_count_, -curr_val);
                 }
             }
@@ -104,41 +140,47 @@ hybrid_bfs::top_down_step_with_migrating_threads()
  * Bottom-up BFS step
  * For each vertex that is not yet a part of the BFS tree,
  * check all in-neighbors to see if they are in the current frontier
- * using a replicated bitmap.
+ * using a striped bitmap.
  * If a parent is found, put the child in the bitmap for the next frontier
  * Returns the number of vertices that found a parent (size of next frontier)
+ * The frontier must be in dense form (see frontier_bitmap::from_queue)
+ * The children are also pushed to the (local) queue, so that the caller can
+ * slide the window to get the next frontier in sparse form, and so that
+ * clear() knows they were visited.
 */
 long
 hybrid_bfs::bottom_up_step()
 {
     awake_count_ = 0;
+    scout_count_ = 0;
+    frontier_.clear_next();
 
     // For all vertices without a parent...
-    g_->for_each_vertex(fixed, [this](long child) {
-        if (parent_[child] >= 0) { return; }
+    g_->for_each_vertex(fixed,
+        [this, push=queue_.make_pusher()](long child) mutable {
+        long curr_val = parent_[child];
+        if (curr_val >= 0) { return; }
         // Look for neighbors who are in the frontier
-        g_->find_out_edge_if(unroll, child, [this, child](long parent) {
+        g_->find_out_edge_if(unroll, child,
+            [this, child, curr_val, &push](long parent) {
             // If the neighbor is in the frontier...
-            if (parent_[parent] >= 0) {
-                // Claim as a parent
-                new_parent_[child] = parent;
+            if (frontier_.get(parent)) {
+                // Claim as a parent. Only the frontier bitmap is read
+                // during this step, so this is safe to do right away.
+                parent_[child] = parent;
+                // Add to the next frontier
+                frontier_.set_next(child);
+                push(child);
+                // Track number of vertices woken up in this step, and the
+                // sum of their degrees
+                remote_add(&awake_count_, 1);
+                remote_add(&scout_count_, -curr_val);
                 // No need to keep searching
                 return true;
             } else return false;
         });
     });
-
-    // Add to the queue all vertices that didn't have a parent before
-    g_->for_each_vertex(fixed, [this](long v) {
-        if (parent_[v] < 0 && new_parent_[v] >= 0) {
-            // Set parent
-            parent_[v] = new_parent_[v];
-            // Add to the queue for the next frontier
-            queue_.push_back(v);
-            // Track number of vertices woken up in this step
-            remote_add(&awake_count_, 1);
-        }
-    });
+    frontier_.advance();
     return repl_reduce(awake_count_, std::plus<>());
 }
 
@@ -161,35 +203,378 @@ hybrid_bfs::run_beamer (long source, long alpha, long beta)
 
     long edges_to_check = g_->num_edges() * 2;
     long scout_count = g_->out_degree(source);
+    // Time spent converting the frontier, charged to the next level
+    long convert_cycles = 0;
 
     // While there are vertices in the queue...
     while (!queue_.all_empty()) {
         if (scout_count > edges_to_check / alpha) {
             long awake_count, old_awake_count;
             awake_count = queue_.combined_size();
+            // Bottom-up steps read the frontier from a bitmap
+            long t0 = CLOCK();
+            frontier_.from_queue(queue_);
+            convert_cycles = CLOCK() - t0;
             // Do bottom-up steps for a while
             do {
                 old_awake_count = awake_count;
-                // hooks_set_attr_i64("awake_count", awake_count);
-                // hooks_region_begin("bottom_up_step");
+                t0 = CLOCK();
                 awake_count = bottom_up_step();
                 queue_.slide_all_windows();
-                // hooks_region_end();
+                level_stats_.push_back({"bottom_up", "dense", awake_count,
+                    convert_cycles, CLOCK() - t0, 0});
+                convert_cycles = 0;
             } while (awake_count >= old_awake_count ||
                     (awake_count > g_->num_vertices() / beta));
+            // The queue already holds the last frontier, go back to
+            // top-down steps
             scout_count = 1;
         } else {
             edges_to_check -= scout_count;
             // Do a top-down step
-            // hooks_region_begin("top_down_step");
+            long t0 = CLOCK();
             scout_count = top_down_step_with_migrating_threads();
             // Slide all queues to explore the next frontier
             queue_.slide_all_windows();
-            // hooks_region_end();
+            long step_cycles = CLOCK() - t0;
+            level_stats_.push_back({"top_down", "sparse",
+                queue_.combined_size(), convert_cycles, step_cycles, 0});
+            convert_cycles = 0;
+        }
+    }
+}
+
+/**
+ * Run BFS choosing the direction of each level with a cost model
+ * Before each level, predict the cost of a top-down step (proportional to
+ * the number of edges out of the frontier) and of a bottom-up step (a fixed
+ * cost for sweeping every vertex, plus the edges not yet explored). Switching
+ * to bottom-up also pays for converting the frontier to a bitmap. The rate
+ * of each kind of work is measured as we go; until it has been, assume
+ * bottom-up is alpha times cheaper than top-down, like Beamer's heuristic.
+ *
+ * The growth of the frontier is measured at each level too. While it is
+ * shrinking, each top-down step is cheaper than the last, so we don't pay
+ * for a conversion to bottom-up that would only be used for a level or two.
+ */
+void
+hybrid_bfs::run_adaptive(long source, long alpha)
+{
+    assert(source < g_->num_vertices());
+
+    // Start with the source vertex in the first frontier, at level 0, and mark it as visited
+    queue_.push_back(source);
+    queue_.slide_all_windows();
+    parent_[source] = source;
+
+    long frontier_size = 1;
+    long frontier_edges = g_->out_degree(source);
+    long unexplored_edges = g_->num_edges() * 2 - frontier_edges;
+    long num_vertices = g_->num_vertices();
+    // Words in the frontier bitmap, which are all cleared by a conversion
+    long num_words = (num_vertices + 63) / 64;
+    double growth = 1.0;
+    bool dense = false;
+
+    while (frontier_size > 0) {
+        // Predict the cost of each direction, in clock cycles
+        double top_down_rate = costs_.top_down_edges > 0
+            ? costs_.top_down_cycles / costs_.top_down_edges : 1.0;
+        double bottom_up_rate = costs_.bottom_up_work > 0
+            ? costs_.bottom_up_cycles / costs_.bottom_up_work
+            : top_down_rate / alpha;
+        double convert_rate = costs_.convert_work > 0
+            ? costs_.convert_cycles / costs_.convert_work : top_down_rate;
+        long convert_work = dense ? 0 : num_words + frontier_size;
+        double top_down_cost = top_down_rate * frontier_edges;
+        double bottom_up_cost = bottom_up_rate * (num_vertices + unexplored_edges)
+            + convert_rate * convert_work;
+        bool bottom_up = bottom_up_cost < top_down_cost
+            && (dense || growth >= 1.0);
+
+        // Convert the frontier if we are switching to bottom-up. Bottom-up
+        // steps also fill the queue, so switching back is free.
+        long t0 = CLOCK();
+        if (bottom_up && !dense) {
+            frontier_.from_queue(queue_);
+        }
+        long convert_cycles = CLOCK() - t0;
+        dense = bottom_up;
+
+        long next_edges;
+        t0 = CLOCK();
+        if (bottom_up) {
+            frontier_size = bottom_up_step();
+            queue_.slide_all_windows();
+            next_edges = repl_reduce(scout_count_, std::plus<>());
+        } else {
+            next_edges = top_down_step_with_migrating_threads();
+            queue_.slide_all_windows();
+            frontier_size = queue_.combined_size();
+        }
+        long step_cycles = CLOCK() - t0;
+
+        // Calibrate the model with the actual cost of this step
+        if (bottom_up) {
+            costs_.bottom_up_cycles += step_cycles;
+            costs_.bottom_up_work += num_vertices + unexplored_edges;
+            if (convert_work > 0) {
+                costs_.convert_cycles += convert_cycles;
+                costs_.convert_work += convert_work;
+            }
+        } else {
+            costs_.top_down_cycles += step_cycles;
+            costs_.top_down_edges += frontier_edges;
+        }
+        level_stats_.push_back({
+            bottom_up ? "bottom_up" : "top_down",
+            bottom_up ? "dense" : "sparse",
+            frontier_size, convert_cycles, step_cycles,
+            (long)(bottom_up ? bottom_up_cost : top_down_cost),
+            growth
+        });
+
+        growth = frontier_edges > 0 ? (double)next_edges / frontier_edges : 1.0;
+        frontier_edges = next_edges;
+        unexplored_edges -= next_edges;
+        if (unexplored_edges < 0) { unexplored_edges = 0; }
+    }
+}
+
+/**
+ * Lower the depth of dst to depth if it is greater, with src as its parent
+ * If dst was improved, queue it to be expanded again
+ */
+void
+hybrid_bfs::async_relax(long src, long dst, long depth)
+{
+    // Atomic min on the depth of the neighbor
+    long old_depth = depth_[dst];
+    while (depth < old_depth) {
+        long prev = atomic_cas(&depth_[dst], old_depth, depth);
+        if (prev == old_depth) {
+            // Log vertices the first time they are reached, so clear()
+            // can find them
+            if (old_depth == LONG_MAX) {
+                queue_.get_nth(dst & (NODELETS() - 1)).push_back(dst);
+            }
+            // This may race with another thread that lowered the depth
+            // further, async_fix_parent repairs it at the end
+            parent_[dst] = src;
+            async_queue_.push(dst);
+            return;
+        }
+        old_depth = prev;
+    }
+}
+
+/**
+ * Expand vertices from the local queue until all the work is done
+ */
+void
+hybrid_bfs::async_worker()
+{
+    long src;
+    for (;;) {
+        if (async_queue_.pop(src)) {
+            // Expand with the current depth, it may have gone down since
+            // src was pushed
+            long depth = depth_[src] + 1;
+            g_->for_each_out_edge(src, [this, src, depth](long dst) {
+                async_relax(src, dst, depth);
+            });
+            async_queue_.done();
+        } else if (async_queue_.is_finished()) {
+            break;
         }
     }
 }
 
+/**
+ * Make sure the parent of v is one level above it
+ * Only a race in async_relax can leave the wrong parent behind
+ */
+void
+hybrid_bfs::async_fix_parent(long v)
+{
+    long depth = depth_[v];
+    if (depth == 0 || depth_[parent_[v]] == depth - 1) { return; }
+    auto e = g_->find_out_edge_if(unroll, v, [this, depth](long u) {
+        return depth_[u] == depth - 1;
+    });
+    assert(e != g_->out_edges_end(v));
+    parent_[v] = *e;
+}
+
+/**
+ * Run BFS without waiting for each level to finish
+ * Threads on each nodelet pull vertices from a local work queue and lower
+ * the depth of their neighbors with an atomic min, queueing each neighbor
+ * they improve. A vertex may be expanded more than once if a shorter path
+ * to it is found later. The search ends when every vertex that was queued on
+ * any nodelet has been expanded, then the parents are repaired in a single
+ * pass.
+ */
+void
+hybrid_bfs::run_async(long source)
+{
+    assert(source < g_->num_vertices());
+
+    // Start with the source vertex at depth 0, and log it as visited
+    async_queue_.reset_all();
+    depth_[source] = 0;
+    parent_[source] = source;
+    queue_.get_nth(source & (NODELETS() - 1)).push_back(source);
+    async_queue_.push(source);
+
+    // Start workers on every nodelet, they run until all queues are empty
+    repl_for_each(parallel_policy<1>(), *this, [this](hybrid_bfs& self) {
+        for (long t = 0; t < threads_per_nodelet; ++t) {
+            // Run on the nodelet of this copy, but call through the
+            // replicated pointer so members resolve to the local copy
+            cilk_spawn_at(&self) async_worker();
+        }
+    });
+
+    // Every vertex that was reached is in the log
+    queue_.forall_pushed([this](long v) { async_fix_parent(v); });
+}
+
+/**
+ * Top-down step for one side of a bidirectional search
+ * The forward search (from the source) uses parent_ and queue_, the backward
+ * search (from the target) uses new_parent_ and reverse_queue_.
+ * Any vertex that is discovered by both searches is recorded in meet_.
+ * Returns the sum of the degrees of the vertices in the new frontier
+ */
+long
+hybrid_bfs::bidirectional_top_down_step(bool backward)
+{
+    auto & parent = backward ? new_parent_ : parent_;
+    auto & other = backward ? parent_ : new_parent_;
+    auto & queue = backward ? reverse_queue_ : queue_;
+
+    scout_count_ = 0;
+    worklist_.clear_all();
+    queue.forall_items(
+        [this, append=worklist_.make_appender()](long src) mutable {
+        append(src, g_->out_edges_begin(src), g_->out_edges_end(src));
+    });
+
+    worklist_.process_all_edges(dynamic_unroll_policy<64>(),
+        [this, &parent, &other, push=queue.make_pusher()]
+        (long src, long dst) mutable {
+            long * p = &parent[dst];
+            long curr_val = *p;
+            // If we are the first to visit this vertex from this side
+            if (curr_val < 0 && atomic_cas(p, curr_val, src) == curr_val) {
+                push(dst);
+                remote_add(&scout_count_, g_->out_degree(dst));
+                // Already visited from the other side?
+                if (other[dst] >= 0) { remote_max(&meet_, dst); }
+            }
+        }
+    );
+    return repl_reduce(scout_count_, std::plus<>());
+}
+
+/**
+ * Bottom-up step for one side of a bidirectional search
+ * Same as bottom_up_step, but the frontier is loaded into the bitmap from the
+ * queue of this side first, and the next frontier only goes to the queue.
+ * Returns the sum of the degrees of the vertices in the new frontier
+ */
+long
+hybrid_bfs::bidirectional_bottom_up_step(bool backward)
+{
+    auto & parent = backward ? new_parent_ : parent_;
+    auto & other = backward ? parent_ : new_parent_;
+    auto & queue = backward ? reverse_queue_ : queue_;
+
+    frontier_.from_queue(queue);
+    scout_count_ = 0;
+    g_->for_each_vertex(fixed,
+        [this, &parent, &other, push=queue.make_pusher()](long child) mutable {
+        if (parent[child] >= 0) { return; }
+        g_->find_out_edge_if(unroll, child, [&](long p) {
+            if (frontier_.get(p)) {
+                parent[child] = p;
+                push(child);
+                remote_add(&scout_count_, g_->out_degree(child));
+                if (other[child] >= 0) { remote_max(&meet_, child); }
+                return true;
+            } else return false;
+        });
+    });
+    return repl_reduce(scout_count_, std::plus<>());
+}
+
+/**
+ * Find a shortest path from source to target with a bidirectional BFS
+ * Grows a BFS tree from each end, always expanding the side whose frontier
+ * has fewer edges, and stops after the first level where they meet. Each
+ * side picks top-down or bottom-up steps with Beamer's alpha heuristic.
+ *
+ * The first level to discover a vertex that the other side already visited
+ * only discovers vertices at the other side's current depth (a vertex any
+ * closer to the other end would have been found one level earlier), so any
+ * meeting vertex from that level is on a shortest path.
+ *
+ * @param path Filled with the vertices on the path, including both ends
+ * @return The length of the path, or -1 if target is not reachable
+ */
+long
+hybrid_bfs::run_bidirectional(long source, long target, long alpha,
+    std::vector<long> & path)
+{
+    assert(source < g_->num_vertices());
+    assert(target < g_->num_vertices());
+    path.clear();
+
+    // Root a tree at each end
+    queue_.push_back(source);
+    queue_.slide_all_windows();
+    parent_[source] = source;
+    reverse_queue_.push_back(target);
+    reverse_queue_.slide_all_windows();
+    new_parent_[target] = target;
+    meet_ = -1;
+
+    // Per-side state, indexed by backward
+    long scout_count[2] = { g_->out_degree(source), g_->out_degree(target) };
+    long edges_to_check[2] = { g_->num_edges() * 2, g_->num_edges() * 2 };
+
+    long meet = source == target ? source : -1;
+    while (meet < 0) {
+        // If either side runs out of vertices, there is no path
+        if (queue_.all_empty() || reverse_queue_.all_empty()) { break; }
+        // Expand the cheaper side
+        bool backward = scout_count[1] < scout_count[0];
+        long side = backward ? 1 : 0;
+        if (scout_count[side] > edges_to_check[side] / alpha) {
+            scout_count[side] = bidirectional_bottom_up_step(backward);
+        } else {
+            edges_to_check[side] -= scout_count[side];
+            scout_count[side] = bidirectional_top_down_step(backward);
+        }
+        (backward ? reverse_queue_ : queue_).slide_all_windows();
+        meet = repl_reduce(meet_, [](long a, long b) { return std::max(a, b); });
+    }
+    if (meet < 0) { return -1; }
+
+    // Walk back to the source, then forward to the target
+    for (long v = meet; ; v = parent_[v]) {
+        path.push_back(v);
+        if (v == source) { break; }
+    }
+    std::reverse(path.begin(), path.end());
+    for (long v = meet; v != target; ) {
+        v = new_parent_[v];
+        path.push_back(v);
+    }
+    return path.size() - 1;
+}
+
 /**
  * Run BFS using top-down steps with migrating threads
  */
@@ -378,6 +763,157 @@ hybrid_bfs::check(long source)
     return correct;
 }
 
+/**
+ * Check the result of run_bidirectional against a serial BFS from the source
+ * The path must be a chain of edges from source to target, as short as the
+ * distance found by the serial BFS. An empty path means it is unreachable.
+ */
+bool
+hybrid_bfs::check_path(long source, long target, const std::vector<long> & path)
+{
+    std::vector<long> depth(g_->num_vertices(), -1);
+    std::queue<long> q;
+    q.push(source);
+    depth[source] = 0;
+    while (!q.empty() && depth[target] < 0) {
+        long u = q.front(); q.pop();
+        auto edges_begin = g_->out_neighbors(u);
+        auto edges_end = edges_begin + g_->out_degree(u);
+        for (auto e = edges_begin; e < edges_end; ++e) {
+            long v = *e;
+            if (depth[v] == -1) {
+                depth[v] = depth[u] + 1;
+                q.push(v);
+            }
+        }
+    }
+
+    if (path.empty()) {
+        if (depth[target] >= 0) {
+            LOG("No path found, but %li is reachable from %li\n", target, source);
+            return false;
+        }
+        return true;
+    }
+    if (path.front() != source || path.back() != target) {
+        LOG("Path does not go from %li to %li\n", source, target);
+        return false;
+    }
+    if ((long)path.size() - 1 != depth[target]) {
+        LOG("Path has length %li, shortest is %li\n",
+            (long)path.size() - 1, depth[target]);
+        return false;
+    }
+    for (long i = 1; i < (long)path.size(); ++i) {
+        if (g_->find_out_edge(path[i-1], path[i]) == g_->out_edges_end(path[i-1])) {
+            LOG("Couldn't find edge from %li to %li\n", path[i-1], path[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Check the BFS tree with the five rules from the Graph500 specification
+ *  1. The tree has no cycles, and every vertex in it leads back to the root
+ *  2. Each tree edge connects vertices whose levels differ by exactly one
+ *  3. Each edge in the graph connects vertices whose levels differ by at
+ *     most one, or that are both outside the tree
+ *  4. The tree spans a whole connected component (no edge leaves it)
+ *  5. Each vertex and its parent are joined by an edge in the graph
+ * Unlike check(), everything runs in parallel, so that validation costs
+ * about as much as the search. The levels are computed from the parent
+ * array in one pass per level, and stored in depth_.
+ * The graph is built from the edge list with both directions of every edge,
+ * so rules 3 and 4 are checked against the out-edges of each vertex.
+ */
+bool
+hybrid_bfs::validate(long source)
+{
+    // Number of violations of each rule
+    long errors[5] = {0, 0, 0, 0, 0};
+    long * errors_ptr = errors;
+
+    if (parent_[source] != source) {
+        LOG("Root %li is not its own parent\n", source);
+        return false;
+    }
+
+    // Assign levels in a single pass. Each vertex climbs its parent chain
+    // until it finds a vertex that already has a level, then labels the
+    // vertices it climbed through on the way back down, so later climbs stop
+    // early. Threads that climb the same chain at once write the same
+    // levels. Chains that end outside the tree or loop are left unlabeled.
+    g_->for_each_vertex(fixed, [this](long v) {
+        depth_[v] = LONG_MAX;
+    });
+    depth_[source] = 0;
+    g_->for_each_vertex(dyn, [this](long v) {
+        if (parent_[v] < 0) { return; }
+        long u = v;
+        long steps = 0;
+        while (depth_[u] == LONG_MAX) {
+            long parent = parent_[u];
+            if (parent < 0 || steps >= g_->num_vertices()) { return; }
+            u = parent;
+            ++steps;
+        }
+        long depth = depth_[u] + steps;
+        for (u = v; steps > 0; --steps, --depth) {
+            depth_[u] = depth;
+            u = parent_[u];
+        }
+    });
+
+    // Vertex rules: every tree vertex got a level, its parent is one level
+    // up, and is one of its neighbors
+    g_->for_each_vertex(fixed, [this, source, errors_ptr](long v) {
+        long parent = parent_[v];
+        if (parent < 0 || v == source) { return; }
+        if (depth_[v] == LONG_MAX) {
+            remote_add(&errors_ptr[0], 1);
+            return;
+        }
+        if (depth_[parent] != depth_[v] - 1) {
+            remote_add(&errors_ptr[1], 1);
+        }
+        if (g_->find_out_edge(v, parent) == g_->out_edges_end(v)) {
+            remote_add(&errors_ptr[4], 1);
+        }
+    });
+
+    // Edge rules: no edge skips a level or leaves the tree
+    worklist_.clear_all();
+    g_->for_each_vertex(fixed,
+        [this, append=worklist_.make_appender()](long v) mutable {
+        append(v, g_->out_edges_begin(v), g_->out_edges_end(v));
+    });
+    worklist_.process_all_edges(dynamic_policy<64>(),
+        [this, errors_ptr](long src, long dst) {
+            bool src_in_tree = parent_[src] >= 0;
+            bool dst_in_tree = parent_[dst] >= 0;
+            if (src_in_tree != dst_in_tree) {
+                remote_add(&errors_ptr[3], 1);
+            } else if (src_in_tree) {
+                long diff = depth_[src] - depth_[dst];
+                if (diff > 1 || diff < -1) {
+                    remote_add(&errors_ptr[2], 1);
+                }
+            }
+        }
+    );
+
+    bool correct = true;
+    for (long rule = 0; rule < 5; ++rule) {
+        if (errors[rule] > 0) {
+            LOG("Validation rule %li failed for %li vertices/edges\n",
+                rule + 1, errors[rule]);
+            correct = false;
+        }
+    }
+    return correct;
+}
+
 void
 hybrid_bfs::print_tree()
 {
@@ -423,21 +959,61 @@ hybrid_bfs::dump_queue_stats()
 
     printf("Frontier size per nodelet: ");
     for (long n = 0; n < NODELETS(); ++n) {
-        sliding_queue & local_queue = queue_.get_nth(n);
+        chunked_queue & local_queue = queue_.get_nth(n);
         printf("%li ", local_queue.size());
     }
     printf("\n");
     fflush(stdout);
 }
 
+const std::vector<hybrid_bfs::level_stats>&
+hybrid_bfs::get_level_stats() const
+{
+    return level_stats_;
+}
+
+void
+hybrid_bfs::print_level_stats() const
+{
+    for (long i = 0; i < (long)level_stats_.size(); ++i) {
+        const level_stats & s = level_stats_[i];
+        LOG("Level %3li: %-9s %-6s discovered %10li, "
+            "convert %10li cycles, step %10li cycles",
+            i + 1, s.step, s.frontier, s.num_discovered,
+            s.convert_cycles, s.step_cycles);
+        if (s.predicted_cycles > 0) {
+            LOG(" (predicted %li, growth %3.2f)",
+                s.predicted_cycles, s.growth);
+        }
+        LOG("\n");
+    }
+}
+
+/**
+ * Reset the BFS state before the next search
+ * Every vertex visited by a search is pushed to a queue exactly once, and
+ * new_parent_ is only written for neighbors of visited vertices, which have
+ * been visited too. So only the vertices in the queues need to be reset,
+ * unless this is the first call.
+ */
 void
 hybrid_bfs::clear()
 {
-    g_->for_each_vertex([&](long v) {
+    auto reset = [this](long v) {
         long out_degree = g_->out_degree(v);
         parent_[v] = out_degree != 0 ? -out_degree : -1;
         new_parent_[v] = -1;
-    });
-    // Reset the queue
+        depth_[v] = LONG_MAX;
+    };
+    if (needs_full_clear_) {
+        g_->for_each_vertex(reset);
+        needs_full_clear_ = false;
+    } else {
+        queue_.forall_pushed(reset);
+        reverse_queue_.forall_pushed(reset);
+    }
+    // Reset the queues
     queue_.reset_all();
+    reverse_queue_.reset_all();
+    level_stats_.clear();
 }
@@ -5,7 +5,9 @@
 #include <emu_cxx_utils/execution_policy.h>
 #include "common.h"
 #include "graph.h"
-#include "sliding_queue.h"
+#include "chunked_queue.h"
+#include "frontier_bitmap.h"
+#include "async_queue.h"
 #include "worklist.h"
 
 class hybrid_bfs {
@@ -14,9 +16,25 @@ private:
     // For each vertex, parent in the BFS tree.
     emu::striped_array<long> parent_;
     // Temporary copy of parent array
+    // Also holds the tree grown from the target in run_bidirectional
     emu::striped_array<long> new_parent_;
     // Used to store vertices to visit in the next frontier
-    sliding_queue queue_;
+    chunked_queue queue_;
+    // Frontier of the search from the target in run_bidirectional
+    chunked_queue reverse_queue_;
+    // Vertex where the two searches met in run_bidirectional (max per nodelet)
+    emu::repl<long> meet_;
+    // Dense copy of the frontier, used during bottom-up steps
+    frontier_bitmap frontier_;
+    // When set, remote-write steps log the vertices they write to, and only
+    // those are checked for a new parent afterwards
+    bool sparse_levels_;
+    // Vertices written during a remote-write step (next plane only)
+    frontier_bitmap touched_;
+    // Depth of each vertex, only used by run_async and validate
+    emu::striped_array<long> depth_;
+    // Vertices waiting to be expanded by run_async
+    async_queue async_queue_;
     // Tracks the sum of the degrees of vertices in the frontier
     // Declared here to avoid re-allocating before each step
     emu::repl<long> scout_count_;
@@ -24,11 +42,58 @@ private:
 
     worklist<graph::edge_type> worklist_;
 
+public:
+    struct level_stats {
+        // Which step was used to explore this level
+        const char * step;
+        // Frontier representation used by the step ("sparse" or "dense")
+        const char * frontier;
+        // Number of vertices discovered at this level
+        long num_discovered;
+        // Clock cycles spent converting the frontier before this level
+        long convert_cycles;
+        // Clock cycles spent in the step itself
+        long step_cycles;
+        // Cost of the conversion and step predicted by run_adaptive (zero
+        // otherwise)
+        long predicted_cycles;
+        // Edges out of the frontier divided by edges out of the previous
+        // frontier, as seen by run_adaptive when choosing the direction
+        double growth;
+    };
+private:
+    // Per-level stats from the last call to run_beamer or run_adaptive
+    std::vector<level_stats> level_stats_;
+
+    // Cost model used by run_adaptive: total clock cycles spent in each kind
+    // of step, and the amount of work the model charges them for. Top-down
+    // is charged for frontier edges, bottom-up for every vertex it sweeps
+    // plus the unexplored edges, and converting the frontier for the bitmap
+    // words it clears plus the frontier vertices. Not reset by clear(), so
+    // each search is calibrated by the ones before it.
+    struct cost_model {
+        double top_down_cycles;
+        double top_down_edges;
+        double bottom_up_cycles;
+        double bottom_up_work;
+        double convert_cycles;
+        double convert_work;
+    } costs_;
+
+    // Set until clear() has initialized every vertex. After that, clear()
+    // only resets the vertices visited by the last search.
+    bool needs_full_clear_;
+
     void dump_queue_stats();
 
     long top_down_step_with_remote_writes();
     long top_down_step_with_migrating_threads();
     long bottom_up_step();
+    void async_worker();
+    void async_relax(long src, long dst, long depth);
+    void async_fix_parent(long v);
+    long bidirectional_top_down_step(bool backward);
+    long bidirectional_bottom_up_step(bool backward);
 
 public:
 
@@ -36,12 +101,20 @@ public:
     void run_with_migrating_threads(long source);
     void run_with_remote_writes_hybrid(long source, long alpha, long beta);
     void run_beamer(long source, long alpha, long beta);
+    void run_adaptive(long source, long alpha);
+    void run_async(long source);
+    long run_bidirectional(long source, long target, long alpha,
+        std::vector<long> & path);
 
-    explicit hybrid_bfs(graph & g);
+    explicit hybrid_bfs(graph & g, bool sparse_levels = false);
     hybrid_bfs(const hybrid_bfs& other, emu::shallow_copy tag);
 
     void clear();
     bool check(long source);
+    bool validate(long source);
+    bool check_path(long source, long target, const std::vector<long> & path);
     void print_tree();
     long count_num_traversed_edges();
+    const std::vector<level_stats>& get_level_stats() const;
+    void print_level_stats() const;
 };
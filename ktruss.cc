@@ -101,12 +101,13 @@ void
 ktruss::count_triangles()
 {
     worklist_.clear_all();
-    g_->for_each_vertex(fixed, [this](long p) {
+    g_->for_each_vertex(fixed,
+        [this, append=worklist_.make_appender()](long p) mutable {
         // Add all active edges of p to the worklist
         auto q_begin = g_->out_edges_begin(p);
         auto q_end = active_edges_end_[p];
         if (q_begin != q_end) {
-            worklist_.append(p, q_begin, q_end);
+            append(p, q_begin, q_end);
         }
         // Init all triangle counts to zero
         std::for_each(q_begin, q_end, [](ktruss_edge_slot &dst) {
@@ -164,7 +165,8 @@ ktruss::compute_truss_sizes(long max_k)
 
     // Rebuild the worklist to include all edges that were removed
     worklist_.clear_all();
-    g_->for_each_vertex(dyn, [this](long p) {
+    g_->for_each_vertex(dyn,
+        [this, append=worklist_.make_appender()](long p) mutable {
         // Sort the edge list
         auto edges_begin = g_->out_edges_begin(p);
         auto edges_end = g_->out_edges_end(p);
@@ -173,7 +175,7 @@ ktruss::compute_truss_sizes(long max_k)
         edges_end = std::lower_bound(edges_begin, edges_end, p);
         // Add these edges to the work list
         if (edges_begin != edges_end) {
-            worklist_.append(p, edges_begin, edges_end);
+            append(p, edges_begin, edges_end);
         }
     });
     worklist_.process_all_edges(dynamic_policy<64>(),
@@ -1,7 +1,7 @@
 #include <vector>
 #include <emu_cxx_utils/replicated.h>
 #include "ktruss_graph.h"
-#include "worklist.h"
+#include "array_worklist.h"
 
 class ktruss
 {
@@ -28,7 +28,7 @@ private:
     // Number of edges removed in current step
     emu::repl<long> num_removed_;
     // Work list of edges to process
-    worklist<ktruss_graph::edge_type> worklist_;
+    array_worklist<ktruss_graph::edge_type> worklist_;
 
     // Counts the number of triangles per edge
     void count_triangles();
@@ -0,0 +1,244 @@
+#include "ms_bfs.h"
+#include <cassert>
+#include <algorithm>
+#include <queue>
+#include <vector>
+#include <emu_cxx_utils/execution_policy.h>
+#include <emu_cxx_utils/for_each.h>
+#include <emu_cxx_utils/fill.h>
+
+using namespace emu;
+using namespace emu::parallel;
+
+ms_bfs::ms_bfs(graph & g)
+: g_(&g)
+, seen_(g.num_vertices())
+, visit_(g.num_vertices())
+, visit_next_(g.num_vertices())
+, active_count_(0L)
+, worklist_(g.num_vertices())
+, num_sources_(0)
+{
+    clear();
+}
+
+// Shallow copy constructor
+ms_bfs::ms_bfs(const ms_bfs& other, emu::shallow_copy shallow)
+: g_(other.g_)
+, seen_(other.seen_, shallow)
+, visit_(other.visit_, shallow)
+, visit_next_(other.visit_next_, shallow)
+, active_count_(other.active_count_)
+, worklist_(other.worklist_, shallow)
+, num_sources_(0)
+{}
+
+void
+ms_bfs::clear()
+{
+    g_->for_each_vertex(fixed, [this](long v) {
+        seen_[v] = 0;
+        visit_[v] = 0;
+        visit_next_[v] = 0;
+    });
+}
+
+namespace {
+
+/**
+ * Counts vertices and edges reached by each search in a thread-private
+ * array, then adds them to the copy of the replicated counters on the
+ * nodelet it goes out of scope on.
+ * Captured by value in a mutable lambda, like the reducers.
+ */
+class source_counter
+{
+private:
+    long * reached_;
+    long * edges_;
+    long local_reached_[ms_bfs::max_sources];
+    long local_edges_[ms_bfs::max_sources];
+    // Highest source index + 1 that has a nonzero count
+    long size_;
+public:
+    source_counter(long * reached, long * edges)
+    : reached_(reached), edges_(edges), size_(0) {}
+
+    // Copy constructor: refer to the same counters, but start from zero
+    source_counter(const source_counter& other)
+    : source_counter(other.reached_, other.edges_) {}
+
+    ~source_counter()
+    {
+        long * reached = emu::pmanip::get_nth(reached_, NODE_ID());
+        long * edges = emu::pmanip::get_nth(edges_, NODE_ID());
+        for (long s = 0; s < size_; ++s) {
+            if (local_reached_[s]) {
+                emu::remote_add(&reached[s], local_reached_[s]);
+                emu::remote_add(&edges[s], local_edges_[s]);
+            }
+        }
+    }
+
+    // Count a vertex with the given degree for each search in the mask
+    void add(unsigned long mask, long degree)
+    {
+        for (; mask != 0; mask &= mask - 1) {
+            long s = __builtin_ctzl(mask);
+            // Zero out counters the first time they are used
+            for (; size_ <= s; ++size_) {
+                local_reached_[size_] = 0;
+                local_edges_[size_] = 0;
+            }
+            local_reached_[s] += 1;
+            local_edges_[s] += degree;
+        }
+    }
+};
+
+} // end anonymous namespace
+
+/**
+ * Explore one level of all the searches at once
+ * Returns the number of vertices in the next frontier
+ */
+long
+ms_bfs::visit_level(long level)
+{
+    // Build a worklist of all the edges out of the frontier
+    worklist_.clear_all();
+    g_->for_each_vertex(fixed,
+        [this, append=worklist_.make_appender()](long v) mutable {
+        if (visit_[v] != 0) {
+            append(v, g_->out_edges_begin(v), g_->out_edges_end(v));
+        }
+    });
+
+    // For each edge out of the frontier, propagate the searches that
+    // have not seen the destination yet
+    worklist_.process_all_edges(dynamic_policy<64>(),
+        [this](long src, long dst) {
+            unsigned long next = visit_[src] & ~seen_[dst];
+            if (next != 0) {
+                remote_or(&visit_next_[dst], next);
+            }
+        }
+    );
+
+    // Mark newly reached vertices as seen and swap in the next frontier
+    active_count_ = 0;
+    for (long s = 0; s < max_sources; ++s) {
+        for (long n = 0; n < NODELETS(); ++n) {
+            pmanip::get_nth(this, n)->level_reached_[s] = 0;
+            pmanip::get_nth(this, n)->level_edges_[s] = 0;
+        }
+    }
+    g_->for_each_vertex(fixed,
+        [this, count=source_counter(level_reached_, level_edges_)]
+        (long v) mutable {
+        unsigned long next = visit_next_[v] & ~seen_[v];
+        visit_next_[v] = 0;
+        visit_[v] = next;
+        if (next != 0) {
+            seen_[v] |= next;
+            count.add(next, g_->out_degree(v));
+            remote_add(&active_count_, 1);
+        }
+    });
+    reduce_level_stats(level);
+    return repl_reduce(active_count_, std::plus<>());
+}
+
+// Combine the per-nodelet counts for this level into the results
+void
+ms_bfs::reduce_level_stats(long level)
+{
+    for (long s = 0; s < num_sources_; ++s) {
+        long reached = 0, edges = 0;
+        for (long n = 0; n < NODELETS(); ++n) {
+            reached += pmanip::get_nth(this, n)->level_reached_[s];
+            edges += pmanip::get_nth(this, n)->level_edges_[s];
+        }
+        if (reached > 0) {
+            stats_[s].num_reached += reached;
+            stats_[s].depth_sum += reached * level;
+            stats_[s].max_depth = level;
+            stats_[s].edge_sum += edges;
+        }
+    }
+}
+
+long
+ms_bfs::run(const long * sources, long num_sources)
+{
+    assert(num_sources > 0 && num_sources <= max_sources);
+    num_sources_ = num_sources;
+    // Each source starts out in its own frontier at level 0
+    for (long s = 0; s < num_sources; ++s) {
+        long src = sources[s];
+        assert(src < g_->num_vertices());
+        seen_[src] |= 1UL << s;
+        visit_[src] |= 1UL << s;
+        stats_[s] = {src, 1, 0, 0, g_->out_degree(src)};
+    }
+    long level;
+    for (level = 1; visit_level(level) > 0; ++level) {}
+    return level;
+}
+
+long
+ms_bfs::count_num_traversed_edges() const
+{
+    long sum = 0;
+    for (long s = 0; s < num_sources_; ++s) {
+        // Divide by two, since each undirected edge is counted twice
+        sum += stats_[s].edge_sum / 2;
+    }
+    return sum;
+}
+
+bool
+ms_bfs::check()
+{
+    std::vector<long> depth(g_->num_vertices());
+    for (long s = 0; s < num_sources_; ++s) {
+        // Do a serial BFS from this source
+        const source_stats & actual = stats_[s];
+        source_stats expected = {actual.source, 0, 0, 0, 0};
+        std::fill(depth.begin(), depth.end(), -1);
+        std::queue<long> q;
+        q.push(actual.source);
+        depth[actual.source] = 0;
+        while (!q.empty()) {
+            long u = q.front(); q.pop();
+            expected.num_reached += 1;
+            expected.depth_sum += depth[u];
+            expected.max_depth = depth[u];
+            expected.edge_sum += g_->out_degree(u);
+            auto edges_begin = g_->out_neighbors(u);
+            auto edges_end = edges_begin + g_->out_degree(u);
+            for (auto e = edges_begin; e < edges_end; ++e) {
+                long v = *e;
+                if (depth[v] == -1) {
+                    depth[v] = depth[u] + 1;
+                    q.push(v);
+                }
+            }
+        }
+        if (expected.num_reached != actual.num_reached
+         || expected.depth_sum != actual.depth_sum
+         || expected.max_depth != actual.max_depth
+         || expected.edge_sum != actual.edge_sum)
+        {
+            LOG("Mismatch for source %li: reached %li/%li, depth sum %li/%li, "
+                "max depth %li/%li, edges %li/%li (actual/expected)\n",
+                actual.source,
+                actual.num_reached, expected.num_reached,
+                actual.depth_sum, expected.depth_sum,
+                actual.max_depth, expected.max_depth,
+                actual.edge_sum, expected.edge_sum);
+            return false;
+        }
+    }
+    return true;
+}
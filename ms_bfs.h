@@ -0,0 +1,80 @@
+#pragma once
+
+#include <emu_cxx_utils/replicated.h>
+#include <emu_cxx_utils/striped_array.h>
+#include "graph.h"
+#include "worklist.h"
+
+/**
+ * Multi-source BFS (Then et al., "The More the Merrier", VLDB 2015)
+ *
+ * Runs up to 64 breadth-first searches at once. Each vertex has a bit mask
+ * of the searches that have seen it, and a bit mask of the searches for which
+ * it is in the frontier. Each edge in the frontier is traversed once for all
+ * the searches that share it, and the masks are combined with remote_or.
+ *
+ * Rather than a depth array for every source, the search keeps per-source
+ * aggregates that are enough for closeness and reachability analysis.
+ */
+class ms_bfs
+{
+public:
+    // Number of searches that can run in a single pass
+    static constexpr long max_sources = 64;
+
+    struct source_stats {
+        long source;
+        // Number of vertices reachable from the source (including itself)
+        long num_reached;
+        // Sum of the distances from the source to each reachable vertex
+        long depth_sum;
+        // Distance to the farthest reachable vertex
+        long max_depth;
+        // Number of edges in the component, counted once in each direction
+        long edge_sum;
+    };
+
+private:
+    emu::repl<graph*> g_;
+    // For each vertex, the searches that have visited it
+    emu::striped_array<unsigned long> seen_;
+    // For each vertex, the searches for which it is in the current frontier
+    emu::striped_array<unsigned long> visit_;
+    // For each vertex, the searches that reached it during this level
+    emu::striped_array<unsigned long> visit_next_;
+    // Number of vertices in the next frontier (summed across nodelets)
+    emu::repl<long> active_count_;
+    // Number of vertices and edges reached by each search during this level.
+    // Each nodelet has a copy, threads add their counts to the copy on the
+    // nodelet they finish on. Summed across nodelets after each level.
+    long level_reached_[max_sources];
+    long level_edges_[max_sources];
+
+    worklist<graph::edge_type> worklist_;
+
+    // Results for each search in the last call to run
+    long num_sources_;
+    source_stats stats_[max_sources];
+
+    long visit_level(long level);
+    void reduce_level_stats(long level);
+
+public:
+    explicit ms_bfs(graph & g);
+    ms_bfs(const ms_bfs& other, emu::shallow_copy);
+
+    /**
+     * Run a BFS from each source concurrently
+     * @param sources Array of source vertices
+     * @param num_sources Number of sources, at most max_sources
+     * @return Number of levels explored
+     */
+    long run(const long * sources, long num_sources);
+    void clear();
+    bool check();
+
+    long num_sources() const { return num_sources_; }
+    const source_stats& get_stats(long i) const { return stats_[i]; }
+    // Total number of edges traversed by all searches
+    long count_num_traversed_edges() const;
+};
@@ -1,5 +1,6 @@
 #include "pagerank.h"
 #include <cmath>
+#include <utility>
 #include <vector>
 #include <emu_cxx_utils/execution_policy.h>
 #include <emu_cxx_utils/for_each.h>
@@ -17,7 +18,16 @@ pagerank::pagerank(graph & g)
 , error_(0)
 , base_score_(0)
 , damping_(0)
-, worklist_(g.num_vertices())
+, num_active_(0L)
+, num_edges_(0L)
+, num_edges_processed_(0)
+// Split vertices with more than 4K edges across nodelets
+, worklist_(g.num_vertices(), g.num_edges() * 2, 4096)
+, residual_(nullptr)
+, schedule_(nullptr)
+, float_scores_(nullptr)
+, float_contrib_(nullptr)
+, single_precision_(false)
 {}
 
 // Shallow copy constructor
@@ -29,22 +39,55 @@ pagerank::pagerank(const pagerank& other, emu::shallow_copy shallow)
 , error_(other.error_)
 , base_score_(other.base_score_)
 , damping_(other.damping_)
+, num_active_(other.num_active_)
+, num_edges_(other.num_edges_)
+, num_edges_processed_(0)
 , worklist_(other.worklist_, shallow)
+, residual_(other.residual_)
+, schedule_(other.schedule_)
+, float_scores_(other.float_scores_)
+, float_contrib_(other.float_contrib_)
+, single_precision_(false)
 {}
 
+// Only called on the original copy, which owns the optional state
+pagerank::~pagerank()
+{
+    delete residual_.get();
+    delete schedule_.get();
+    delete float_scores_.get();
+    delete float_contrib_.get();
+}
+
+namespace {
+
+// Allocate a replicated object the first time it is needed
+template<class T, class... Args>
+void
+allocate_once(emu::repl<emu::repl_shallow<T>*> & ptr, Args&&... args)
+{
+    if (ptr.get() == nullptr) {
+        ptr = new emu::repl_shallow<T>(std::forward<Args>(args)...);
+    }
+}
+
+} // end anonymous namespace
+
 int
 pagerank::run (int max_iters, double damping, double epsilon)
 {
     // Initialize scores for all vertices
     double init_score = 1.0 / g_->num_vertices();
     fill(scores_.begin(), scores_.end(), init_score);
+    single_precision_ = false;
     // Init replicated constants
     base_score_ = (1.0 - damping) / g_->num_vertices();
     damping_ = damping;
     int iter;
     for (iter = 0; iter < max_iters; ++iter) {
         worklist_.clear_all();
-        g_->for_each_vertex(fixed, [this](long v) {
+        g_->for_each_vertex(fixed,
+            [this, append=worklist_.make_appender()](long v) mutable {
             // Initialize incoming contribution to zero
             incoming_[v] = 0;
             // Compute outgoing contribution as score over degree
@@ -53,10 +96,10 @@ pagerank::run (int max_iters, double damping, double epsilon)
             // Append all edges to the work list
             auto begin = g_->out_edges_begin(v);
             auto end = g_->out_edges_end(v);
-            worklist_.append(v, begin, end);
+            append(v, begin, end);
         });
 
-        worklist_.process_all_ranges(dynamic_policy<256>(),
+        worklist_.process_all_ranges(stealing_policy<256>(),
             [contrib=contrib_.data(),incoming=incoming_.data()]
             (long src, graph::edge_iterator e1, graph::edge_iterator e2) {
                 // Sum incoming contribution from all my neighbors
@@ -90,6 +133,272 @@ pagerank::run (int max_iters, double damping, double epsilon)
     return iter;
 }
 
+void
+pagerank::prepare_static()
+{
+    allocate_once(schedule_, *g_, 256L);
+}
+
+void
+pagerank::prepare_float()
+{
+    prepare_static();
+    allocate_once(float_scores_, g_->num_vertices());
+    allocate_once(float_contrib_, g_->num_vertices());
+}
+
+void
+pagerank::prepare_delta()
+{
+    allocate_once(residual_, g_->num_vertices());
+}
+
+int
+pagerank::run_static (int max_iters, double damping, double epsilon)
+{
+    prepare_static();
+    double init_score = 1.0 / g_->num_vertices();
+    single_precision_ = false;
+    base_score_ = (1.0 - damping) / g_->num_vertices();
+    damping_ = damping;
+    // Set up the first iteration
+    g_->for_each_vertex(fixed, [this, init_score](long v) {
+        scores_[v] = init_score;
+        incoming_[v] = 0;
+        auto degree = g_->out_degree(v);
+        contrib_[v] = degree > 0 ? init_score / degree : 0;
+    });
+    int iter;
+    for (iter = 0; iter < max_iters; ++iter) {
+        schedule_->process_all_ranges(
+            [contrib=contrib_.data(),incoming=incoming_.data()]
+            (long src, graph::edge_iterator e1, graph::edge_iterator e2) {
+                reducer_opadd<double> accum(&incoming[src]);
+                for_each(unroll, e1, e2,
+                    [accum, contrib] (long dst) mutable {
+                        accum += contrib[dst];
+                    }
+                );
+            }
+        );
+
+        // Update scores and sum the error, then get ready for the next
+        // iteration while the vertex is still in hand
+        error_ = 0;
+        reducer_opadd<double> error(&error_);
+        g_->for_each_vertex(fixed, [this, error](long v) mutable {
+            double old_score = scores_[v];
+            double score = base_score_ + damping_ * incoming_[v];
+            scores_[v] = score;
+            auto diff = score - old_score;
+            if (diff < 0) { diff = -diff; }
+            error += diff;
+            incoming_[v] = 0;
+            auto degree = g_->out_degree(v);
+            if (degree > 0) { contrib_[v] = score / degree; }
+        });
+        double err = repl_reduce(error_, std::plus<>());
+        if (err < epsilon)
+            break;
+    }
+    return iter;
+}
+
+int
+pagerank::run_float (int max_iters, double damping, double epsilon)
+{
+    prepare_float();
+    float init_score = 1.0 / g_->num_vertices();
+    single_precision_ = true;
+    base_score_ = (1.0 - damping) / g_->num_vertices();
+    damping_ = damping;
+    g_->for_each_vertex(fixed, [this, init_score](long v) {
+        (*float_scores_)[v] = init_score;
+        incoming_[v] = 0;
+        auto degree = g_->out_degree(v);
+        (*float_contrib_)[v] = degree > 0 ? init_score / degree : 0;
+    });
+    int iter;
+    for (iter = 0; iter < max_iters; ++iter) {
+        schedule_->process_all_ranges(
+            [this, incoming=incoming_.data()]
+            (long src, graph::edge_iterator e1, graph::edge_iterator e2) {
+                // Sum in double, only the reads are narrower
+                double sum = 0;
+                for (auto e = e1; e < e2; ++e) { sum += (*float_contrib_)[*e]; }
+                op_add<double>::reduce(&incoming[src], sum);
+            }
+        );
+
+        error_ = 0;
+        reducer_opadd<double> error(&error_);
+        g_->for_each_vertex(fixed, [this, error](long v) mutable {
+            double old_score = (*float_scores_)[v];
+            float score = base_score_ + damping_ * incoming_[v];
+            (*float_scores_)[v] = score;
+            // Error is what the stored score actually moved by
+            double diff = score - old_score;
+            if (diff < 0) { diff = -diff; }
+            error += diff;
+            incoming_[v] = 0;
+            auto degree = g_->out_degree(v);
+            if (degree > 0) { (*float_contrib_)[v] = score / degree; }
+        });
+        double err = repl_reduce(error_, std::plus<>());
+        if (err < epsilon)
+            break;
+    }
+    return iter;
+}
+
+#ifndef __le64__
+int
+pagerank::run_blocked (propagation_bins & bins,
+    int max_iters, double damping, double epsilon)
+{
+    double init_score = 1.0 / g_->num_vertices();
+    single_precision_ = false;
+    base_score_ = (1.0 - damping) / g_->num_vertices();
+    damping_ = damping;
+    g_->for_each_vertex(fixed, [this, init_score](long v) {
+        scores_[v] = init_score;
+        incoming_[v] = 0;
+        auto degree = g_->out_degree(v);
+        contrib_[v] = degree > 0 ? init_score / degree : 0;
+    });
+    int iter;
+    for (iter = 0; iter < max_iters; ++iter) {
+        // Neighbors are symmetric, so pushing each contribution to the
+        // neighbors gives the same sums as pulling them
+        bins.bin([contrib=contrib_.data()](long src) { return contrib[src]; });
+        bins.accumulate(incoming_.data());
+
+        error_ = 0;
+        reducer_opadd<double> error(&error_);
+        g_->for_each_vertex(fixed, [this, error](long v) mutable {
+            double old_score = scores_[v];
+            double score = base_score_ + damping_ * incoming_[v];
+            scores_[v] = score;
+            auto diff = score - old_score;
+            if (diff < 0) { diff = -diff; }
+            error += diff;
+            incoming_[v] = 0;
+            auto degree = g_->out_degree(v);
+            if (degree > 0) { contrib_[v] = score / degree; }
+        });
+        double err = repl_reduce(error_, std::plus<>());
+        if (err < epsilon)
+            break;
+    }
+    return iter;
+}
+#endif
+
+double
+pagerank::compare_precision()
+{
+    double error = 0;
+    for (long v = 0; v < g_->num_vertices(); ++v) {
+        error += std::fabs((double)(*float_scores_)[v] - scores_[v]);
+    }
+    return error;
+}
+
+int
+pagerank::run_delta (int max_iters, double damping, double epsilon)
+{
+    prepare_delta();
+    // Initialize scores for all vertices, as in run
+    double init_score = 1.0 / g_->num_vertices();
+    fill(scores_.begin(), scores_.end(), init_score);
+    single_precision_ = false;
+    base_score_ = (1.0 - damping) / g_->num_vertices();
+    damping_ = damping;
+
+    // The first residual needs a full pass over the edges
+    worklist_.clear_all();
+    g_->for_each_vertex(fixed,
+        [this, append=worklist_.make_appender()](long v) mutable {
+        incoming_[v] = 0;
+        auto degree = g_->out_degree(v);
+        contrib_[v] = degree > 0 ? scores_[v] / degree : 0;
+        append(v, g_->out_edges_begin(v), g_->out_edges_end(v));
+    });
+    worklist_.process_all_ranges(stealing_policy<256>(),
+        [contrib=contrib_.data(),incoming=incoming_.data()]
+        (long src, graph::edge_iterator e1, graph::edge_iterator e2) {
+            reducer_opadd<double> accum(&incoming[src]);
+            for_each(unroll, e1, e2,
+                [accum, contrib] (long dst) mutable {
+                    accum += contrib[dst];
+                }
+            );
+        }
+    );
+    error_ = 0;
+    reducer_opadd<double> error(&error_);
+    g_->for_each_vertex(fixed, [this, error](long v) mutable {
+        double r = base_score_ + damping_ * incoming_[v] - scores_[v];
+        (*residual_)[v] = r;
+        if (r < 0) { r = -r; }
+        error += r;
+    });
+    double err = repl_reduce(error_, std::plus<>());
+    num_edges_processed_ = g_->num_edges() * 2;
+    // Already converged, like run stopping after its first iteration
+    if (err < epsilon)
+        return 0;
+
+    int iter;
+    for (iter = 0; iter < max_iters; ++iter) {
+        // Move the residual of each vertex that has at least 1/8 of the
+        // average residual per edge into its score, and queue up its edges
+        // to pass it on. Pushing everything would be the same as run.
+        double threshold = err / (8 * g_->num_edges() * 2);
+        num_active_ = 0;
+        num_edges_ = 0;
+        worklist_.clear_all();
+        g_->for_each_vertex(fixed, [this, threshold,
+            append=worklist_.make_appender()](long v) mutable {
+            double r = (*residual_)[v];
+            auto degree = g_->out_degree(v);
+            double t = threshold * degree;
+            if (r == 0 || (r < t && r > -t)) { return; }
+            (*residual_)[v] = 0;
+            scores_[v] += r;
+            remote_add(&num_active_, 1);
+            if (degree > 0) {
+                contrib_[v] = damping_ * r / degree;
+                remote_add(&num_edges_, degree);
+                append(v, g_->out_edges_begin(v), g_->out_edges_end(v));
+            }
+        });
+        worklist_.process_all_edges(dynamic_policy<64>(),
+            [this](long src, long dst) {
+                op_add<double>::reduce(&(*residual_)[dst], contrib_[src]);
+            }
+        );
+
+        // Sum the residuals that are left
+        error_ = 0;
+        reducer_opadd<double> error(&error_);
+        g_->for_each_vertex(fixed, [this, error](long v) mutable {
+            double r = (*residual_)[v];
+            if (r < 0) { r = -r; }
+            error += r;
+        });
+        err = repl_reduce(error_, std::plus<>());
+
+        long num_edges = repl_reduce(num_edges_, std::plus<>());
+        num_edges_processed_ += num_edges;
+        LOG("Iteration %i: %li active vertices, %li edges, residual %3.2e\n",
+            iter, repl_reduce(num_active_, std::plus<>()), num_edges, err);
+        if (err < epsilon)
+            break;
+    }
+    return iter;
+}
+
 void
 pagerank::clear()
 {
@@ -104,14 +413,14 @@ pagerank::check(double damping, double target_error)
   g_->for_each_vertex(seq, [&](long u){
       long degree = g_->out_degree(u);
       double outgoing_contrib = degree == 0 ? 0 :
-          scores_[u] / degree;
+          (*this)[u] / degree;
       g_->for_each_out_edge(seq, u, [&](long v) {
           incoming_sums[v] += outgoing_contrib;
       });
   });
 
   g_->for_each_vertex(seq, [&](long n){
-    error += fabs(base_score + damping * incoming_sums[n] - scores_[n]);
+    error += fabs(base_score + damping * incoming_sums[n] - (*this)[n]);
     incoming_sums[n] = 0;
   });
 
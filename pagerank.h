@@ -3,9 +3,44 @@
 #include "common.h"
 #include "graph.h"
 #include "worklist.h"
+#include "edge_schedule.h"
+#ifndef __le64__
+#include "propagation_blocking.h"
+#endif
 
 class pagerank
 {
+public:
+    /**
+     * Single-precision value for each vertex. striped_array can only hold
+     * 64-bit types, so the values for the vertices on each nodelet are packed
+     * into a replicated array instead, two to a word. Like a striped_array,
+     * the value for vertex v lives on nodelet v % NODELETS().
+     */
+    class float_array
+    {
+    private:
+        emu::repl_array<float> data_;
+    public:
+        explicit float_array(long num_vertices)
+        : data_((num_vertices + NODELETS() - 1) / NODELETS()) {}
+
+        float_array(const float_array& other, emu::shallow_copy shallow)
+        : data_(other.data_, shallow) {}
+
+        float &
+        operator[](long v)
+        {
+            return data_.get_nth(v & (NODELETS() - 1))[v / NODELETS()];
+        }
+
+        const float &
+        operator[](long v) const
+        {
+            return data_.get_nth(v & (NODELETS() - 1))[v / NODELETS()];
+        }
+    };
+
 private:
     emu::repl<graph*> g_;
     // PageRank value for each vertex
@@ -19,11 +54,32 @@ private:
     // Constants related to applying the damping factor
     emu::repl<double> base_score_;
     emu::repl<double> damping_;
+    // Number of vertices and edges processed in the current iteration
+    emu::repl<long> num_active_;
+    emu::repl<long> num_edges_;
+    // Number of edges processed by the last call to run_delta
+    long num_edges_processed_;
 
     worklist<graph::edge_type> worklist_;
+
+    // State used by only some of the modes is allocated the first time one
+    // of them runs. Each object is replicated, so the pointer can be
+    // followed from any nodelet.
+
+    // Difference between the score each vertex would get from its
+    // neighbors and its current score (run_delta only)
+    emu::repl<emu::repl_shallow<emu::striped_array<double>>*> residual_;
+    // Fixed schedule of all the edges (run_static and run_float)
+    emu::repl<emu::repl_shallow<edge_schedule>*> schedule_;
+    // Single-precision scores and contributions (run_float only)
+    emu::repl<emu::repl_shallow<float_array>*> float_scores_;
+    emu::repl<emu::repl_shallow<float_array>*> float_contrib_;
+    // True if the last run was run_float
+    bool single_precision_;
 public:
     explicit pagerank(graph & g);
     pagerank(const pagerank& other, emu::shallow_copy tag);
+    ~pagerank();
     /**
      * Runs the PageRank algorithm on the graph until convergence or
      * the maximum number of iterations have been reached.
@@ -33,8 +89,67 @@ public:
      * @return Number of iterations performed
      */
     int run (int max_iters, double damping, double epsilon);
+
+    /**
+     * Residual-push PageRank. Starts from the same scores as run, and keeps
+     * the residual of each vertex: the change its score would see in one
+     * more iteration. The residuals add up to the error that check measures.
+     * Each iteration, vertices with a large residual for their degree (at
+     * least 1/8 of the average residual per edge) add it to their score and
+     * push it to their neighbors, so the edges visited go where most of the
+     * error is.
+     * @param max_iters Maximum number of iterations to run
+     * @param damping Damping parameter during rank update
+     * @param epsilon Stop when the residuals add up to less than this
+     * @return Number of iterations performed
+     */
+    int run_delta (int max_iters, double damping, double epsilon);
+
+    /**
+     * Same as run, but visits the edges with a schedule that is built once,
+     * instead of rebuilding the worklist every iteration.
+     * The score update, error sum and contribution for the next iteration
+     * are done in one pass, so each iteration sweeps the edges once and the
+     * vertices once.
+     */
+    int run_static (int max_iters, double damping, double epsilon);
+
+    /**
+     * Same as run_static, but stores the scores and contributions in single
+     * precision, halving the bytes read for each edge. The sum for each
+     * vertex and the error are still accumulated in double precision.
+     * The double-precision scores are left alone, so after calling both
+     * run_static and run_float, compare_precision reports the difference.
+     */
+    int run_float (int max_iters, double damping, double epsilon);
+    // L1 distance between the scores from run_float and run_static
+    double compare_precision();
+
+    // Allocate the state used by each mode ahead of time, so it isn't
+    // counted in the time of the first run. Each run_* method calls its
+    // prepare_* method anyway, which does nothing the second time.
+    void prepare_static();
+    void prepare_float();
+    void prepare_delta();
+
+#ifndef __le64__
+    /**
+     * Same as run_static, but sums the incoming contributions with
+     * propagation blocking, so the reads of other vertices' contributions
+     * stay in cache. Only for x86 builds; there is no cache to block for
+     * on Emu.
+     * @param bins Bins built for this graph
+     */
+    int run_blocked (propagation_bins & bins,
+        int max_iters, double damping, double epsilon);
+#endif
+    // Number of edges processed by the last call to run_delta
+    long num_edges_processed() const { return num_edges_processed_; }
     void clear();
     bool check(double damping, double epsilon);
 
-    double operator[] (size_t i) const { return scores_[i]; }
+    double operator[] (size_t i) const
+    {
+        return single_precision_ ? (*float_scores_)[i] : scores_[i];
+    }
 };
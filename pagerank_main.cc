@@ -1,4 +1,5 @@
 #include <getopt.h>
+#include <memory>
 
 #include "graph.h"
 #include "dist_edge_list.h"
@@ -12,6 +13,8 @@ const struct option long_options[] = {
     {"max_iterations"   , required_argument},
     {"epsilon"          , required_argument},
     {"damping"          , required_argument},
+    {"algorithm"        , required_argument},
+    {"cache_kb"         , required_argument},
     {"sort_edge_blocks" , no_argument},
     {"dump_edge_list"   , no_argument},
     {"check_graph"      , no_argument},
@@ -32,6 +35,9 @@ print_help(const char* argv0)
     LOG("\t--max_iterations     Maximum number of iterations.\n");
     LOG("\t--epsilon            Error tolerance; run until aggregate score change is less than epsilon.\n");
     LOG("\t--damping            Damping factor for pagerank.\n");
+    LOG("\t--algorithm          Select PageRank implementation to run\n");
+    LOG("\t                     (pull, static, delta, float or blocked)\n");
+    LOG("\t--cache_kb           With blocked, size of the last level cache in KB (default: ask the OS)\n");
     LOG("\t--sort_edge_blocks   Sort edge blocks to group neighbors by home nodelet.\n");
     LOG("\t--dump_edge_list     Print the edge list to stdout after loading (slow)\n");
     LOG("\t--check_graph        Validate the constructed graph against the edge list (slow)\n");
@@ -49,6 +55,8 @@ struct pagerank_args
     long max_iterations = 20;
     double epsilon = 1e-5;
     double damping = 0.85;
+    const char* algorithm = "pull";
+    long cache_kb = 0;
     bool sort_edge_blocks = false;
     bool dump_edge_list = false;
     bool check_graph = false;
@@ -85,6 +93,10 @@ struct pagerank_args
                 args.epsilon = atof(optarg);
             } else if (!strcmp(option_name, "damping")) {
                 args.damping = atof(optarg);
+            } else if (!strcmp(option_name, "algorithm")) {
+                args.algorithm = optarg;
+            } else if (!strcmp(option_name, "cache_kb")) {
+                args.cache_kb = atol(optarg);
             } else if (!strcmp(option_name, "sort_edge_blocks")) {
                 args.sort_edge_blocks = true;
             } else if (!strcmp(option_name, "dump_edge_list")) {
@@ -108,6 +120,7 @@ struct pagerank_args
         if (args.max_iterations <= 0) { LOG( "max_iterations must be > 0\n"); exit(1); }
         if (args.damping <= 0) { LOG( "damping must be > 0\n"); exit(1); }
         if (args.epsilon < 0) { LOG( "epsilon must not be negative\n"); exit(1); }
+        if (args.cache_kb < 0) { LOG( "cache_kb must not be negative\n"); exit(1); }
         return args;
     }
 };
@@ -180,7 +193,59 @@ int main(int argc, char ** argv)
     // Initialize the algorithm
     LOG("Initializing PageRank data structures...\n");
 
+    enum pagerank_alg {
+        PULL,
+        STATIC,
+        DELTA,
+        FLOAT,
+        BLOCKED,
+    } alg;
+    if        (!strcmp(args.algorithm, "pull")) {
+        alg = PULL;
+    } else if (!strcmp(args.algorithm, "static")) {
+        alg = STATIC;
+    } else if (!strcmp(args.algorithm, "delta")) {
+        alg = DELTA;
+    } else if (!strcmp(args.algorithm, "float")) {
+        alg = FLOAT;
+    } else if (!strcmp(args.algorithm, "blocked")) {
+#ifdef __le64__
+        LOG("Algorithm 'blocked' is only available in x86 builds\n");
+        exit(1);
+#else
+        alg = BLOCKED;
+#endif
+    } else {
+        LOG("Algorithm '%s' not implemented!\n", args.algorithm);
+        exit(1);
+    }
+    hooks_set_attr_str("algorithm", args.algorithm);
+
     auto pr = emu::make_repl_shallow<pagerank>(*g);
+    // Build what each mode needs now, so it isn't timed
+    switch (alg) {
+        case PULL:
+            break;
+        case STATIC:
+        case BLOCKED: // Also runs the static schedule, for comparison
+            pr->prepare_static();
+            break;
+        case DELTA:
+            pr->prepare_delta();
+            break;
+        case FLOAT:
+            pr->prepare_float();
+            break;
+    }
+#ifndef __le64__
+    std::unique_ptr<propagation_bins> bins;
+    if (alg == BLOCKED) {
+        long bin_width = propagation_bins::bin_width_for_cache(args.cache_kb * 1024);
+        bins = std::make_unique<propagation_bins>(*g, bin_width);
+        LOG("Binned edges into %li bins of %li vertices\n",
+            bins->num_bins(), bins->bin_width());
+    }
+#endif
 
     // Run trials
     double time_ms_all_trials = 0;
@@ -191,7 +256,26 @@ int main(int argc, char ** argv)
         LOG("Computing PageRank...\n");
         // Run the BFS
         hooks_region_begin("pagerank");
-        int num_iters = pr->run(args.max_iterations, args.damping, args.epsilon);
+        int num_iters = 0;
+        switch (alg) {
+            case PULL:
+                num_iters = pr->run(args.max_iterations, args.damping, args.epsilon);
+                break;
+            case STATIC:
+                num_iters = pr->run_static(args.max_iterations, args.damping, args.epsilon);
+                break;
+            case DELTA:
+                num_iters = pr->run_delta(args.max_iterations, args.damping, args.epsilon);
+                break;
+            case FLOAT:
+                num_iters = pr->run_float(args.max_iterations, args.damping, args.epsilon);
+                break;
+            case BLOCKED:
+#ifndef __le64__
+                num_iters = pr->run_blocked(*bins, args.max_iterations, args.damping, args.epsilon);
+#endif
+                break;
+        }
         hooks_set_attr_i64("num_iters", num_iters);
         double time_ms = hooks_region_end();
         if (args.check_results) {
@@ -203,6 +287,28 @@ int main(int argc, char ** argv)
                 success = false;
             }
         }
+        if (alg == FLOAT) {
+            // Run again in double precision (untimed) to see what was lost
+            pr->run_static(args.max_iterations, args.damping, args.epsilon);
+            LOG("Single-precision scores differ from double precision by %3.2e\n",
+                pr->compare_precision());
+        }
+        if (alg == BLOCKED) {
+            // Time the same iterations without blocking, for comparison
+            hooks_region_begin("pagerank_static");
+            int static_iters = pr->run_static(args.max_iterations, args.damping, args.epsilon);
+            double static_time_ms = hooks_region_end();
+            LOG("Static schedule: %i iterations in %3.2f ms, speedup from propagation blocking: %3.2fx\n",
+                static_iters, static_time_ms, static_time_ms / time_ms);
+        }
+
+        time_ms_all_trials += time_ms;
+        if (alg == DELTA) {
+            // Work depends on how many vertices are active each iteration
+            LOG("Computed PageRank in %i iterations, %li edges processed (%3.2f ms)\n",
+                num_iters, pr->num_edges_processed(), time_ms);
+            continue;
+        }
 
         // Compute FLOPS per iteration:
         // 1 FLOP per vertex: (contrib = score / degree)
@@ -219,10 +325,12 @@ int main(int argc, char ** argv)
         // 8 bytes per vertex: (scores_[src] = base_score + damping * incoming);
         // 16 bytes per vertex: error_ += fabs(scores_[src] - old_score);
         // Total 56 bytes per vertex and 8 bytes per edge, per iteration
-        long bytes = num_iters * (56 * g->num_vertices() + 8 * g->num_edges());
+        // Single precision halves the score and contribution traffic
+        long bytes = alg == FLOAT
+            ? num_iters * (36 * g->num_vertices() + 4 * g->num_edges())
+            : num_iters * (56 * g->num_vertices() + 8 * g->num_edges());
 
         // Output results
-        time_ms_all_trials += time_ms;
         LOG("Computed PageRank in %i iterations (%3.2f ms, %3.2f MFLOPS, %3.2f MB/s) \n",
             num_iters, time_ms,
             1e-6*flops/(time_ms*1e-3),
@@ -0,0 +1,402 @@
+#include "ppr.h"
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+#include <emu_cxx_utils/execution_policy.h>
+#include <emu_cxx_utils/for_each.h>
+#include <emu_cxx_utils/reducers.h>
+
+using namespace emu;
+using namespace emu::parallel;
+
+ppr::ppr(graph & g)
+: g_(&g)
+, scores_(g.num_vertices())
+, contrib_(g.num_vertices())
+, incoming_(g.num_vertices())
+, base_(g.num_vertices())
+, damping_(0)
+, schedule_(g, 256)
+{}
+
+// Shallow copy constructor
+ppr::ppr(const ppr& other, emu::shallow_copy shallow)
+: g_(other.g_)
+, scores_(other.scores_, shallow)
+, contrib_(other.contrib_, shallow)
+, incoming_(other.incoming_, shallow)
+, base_(other.base_, shallow)
+, damping_(other.damping_)
+, schedule_(other.schedule_, shallow)
+{}
+
+namespace {
+
+/**
+ * Sums a value for each vector in a thread-private block, then adds them to
+ * the shared sums when it goes out of scope.
+ * Captured by value in a mutable lambda, like the reducers.
+ */
+class block_sum
+{
+private:
+    double * sums_;
+    double local_[ppr::block_size];
+public:
+    explicit block_sum(double * sums) : sums_(sums)
+    {
+        for (long k = 0; k < ppr::block_size; ++k) { local_[k] = 0; }
+    }
+
+    // Copy constructor: refer to the same sums, but start from zero
+    block_sum(const block_sum& other) : block_sum(other.sums_) {}
+
+    ~block_sum()
+    {
+        for (long k = 0; k < ppr::block_size; ++k) {
+            if (local_[k] != 0) { op_add<double>::reduce(&sums_[k], local_[k]); }
+        }
+    }
+
+    double & operator[](long k) { return local_[k]; }
+};
+
+} // end anonymous namespace
+
+int
+ppr::run(const std::vector<std::vector<long>> & seed_sets,
+    int max_iters, double damping, double epsilon)
+{
+    assert(!seed_sets.empty() && (long)seed_sets.size() <= block_size);
+    seed_sets_ = seed_sets;
+    converged_iter_.assign(seed_sets.size(), -1);
+    damping_ = damping;
+
+    // Each walk starts out spread evenly over its seed set
+    g_->for_each_vertex(fixed, [this](long v) {
+        double * base = base_[v];
+        for (long k = 0; k < block_size; ++k) { base[k] = 0; }
+    });
+    for (long k = 0; k < (long)seed_sets.size(); ++k) {
+        for (long s : seed_sets[k]) {
+            assert(s < g_->num_vertices());
+            base_[s][k] += 1.0 / seed_sets[k].size();
+        }
+    }
+    g_->for_each_vertex(fixed, [this](long v) {
+        auto degree = g_->out_degree(v);
+        double * base = base_[v];
+        double * score = scores_[v];
+        double * in = incoming_[v];
+        double * out = contrib_[v];
+        for (long k = 0; k < block_size; ++k) {
+            score[k] = base[k];
+            in[k] = 0;
+            out[k] = degree > 0 ? base[k] / degree : 0;
+            base[k] *= 1.0 - damping_;
+        }
+    });
+
+    int iter;
+    for (iter = 0; iter < max_iters; ++iter) {
+        schedule_.process_all_ranges(
+            [this](long src, graph::edge_iterator e1, graph::edge_iterator e2) {
+                double sum[block_size] = {};
+                for (auto e = e1; e < e2; ++e) {
+                    const double * c = contrib_[*e];
+                    for (long k = 0; k < block_size; ++k) { sum[k] += c[k]; }
+                }
+                double * in = incoming_[src];
+                if (e1 == g_->out_edges_begin(src) && e2 == g_->out_edges_end(src)) {
+                    // This range has all the edges, nobody else writes here
+                    for (long k = 0; k < block_size; ++k) { in[k] = sum[k]; }
+                } else {
+                    for (long k = 0; k < block_size; ++k) {
+                        op_add<double>::reduce(&in[k], sum[k]);
+                    }
+                }
+            }
+        );
+
+        // Update scores and sum the error of each vector, then get ready for
+        // the next iteration
+        double errors[block_size] = {};
+        g_->for_each_vertex(fixed, [this, error=block_sum(errors)](long v) mutable {
+            auto degree = g_->out_degree(v);
+            double * score = scores_[v];
+            double * base = base_[v];
+            double * in = incoming_[v];
+            double * out = contrib_[v];
+            for (long k = 0; k < block_size; ++k) {
+                double new_score = base[k] + damping_ * in[k];
+                double diff = new_score - score[k];
+                error[k] += diff < 0 ? -diff : diff;
+                score[k] = new_score;
+                in[k] = 0;
+                out[k] = degree > 0 ? new_score / degree : 0;
+            }
+        });
+
+        bool done = true;
+        for (long k = 0; k < num_vectors(); ++k) {
+            if (converged_iter_[k] < 0 && errors[k] < epsilon) {
+                converged_iter_[k] = iter;
+            }
+            if (converged_iter_[k] < 0) { done = false; }
+        }
+        if (done) { break; }
+    }
+    return iter;
+}
+
+std::vector<long>
+ppr::top(long k, long n)
+{
+    assert(k < num_vectors());
+    std::vector<long> vertices(g_->num_vertices());
+    for (long v = 0; v < g_->num_vertices(); ++v) { vertices[v] = v; }
+    n = std::min(n, g_->num_vertices());
+    std::partial_sort(vertices.begin(), vertices.begin() + n, vertices.end(),
+        [this, k](long a, long b) {
+            double score_a = score(a, k);
+            double score_b = score(b, k);
+            return score_a != score_b ? score_a > score_b : a < b;
+        }
+    );
+    vertices.resize(n);
+    return vertices;
+}
+
+bool
+ppr::check(double damping, double epsilon)
+{
+    long n = g_->num_vertices();
+    std::vector<double> incoming(n);
+    std::vector<double> base(n);
+    for (long k = 0; k < num_vectors(); ++k) {
+        // The error is only bounded once the vector has converged
+        if (converged_iter_[k] < 0) {
+            LOG("Vector %li did not converge\n", k);
+            return false;
+        }
+        std::fill(incoming.begin(), incoming.end(), 0);
+        std::fill(base.begin(), base.end(), 0);
+        for (long s : seed_sets_[k]) {
+            base[s] += (1.0 - damping) / seed_sets_[k].size();
+        }
+        for (long u = 0; u < n; ++u) {
+            long degree = g_->out_degree(u);
+            if (degree == 0) { continue; }
+            double contrib = score(u, k) / degree;
+            auto edges_begin = g_->out_neighbors(u);
+            auto edges_end = edges_begin + degree;
+            for (auto e = edges_begin; e < edges_end; ++e) {
+                incoming[*e] += contrib;
+            }
+        }
+        double error = 0;
+        for (long v = 0; v < n; ++v) {
+            error += std::fabs(base[v] + damping * incoming[v] - score(v, k));
+        }
+        if (error >= epsilon) {
+            LOG("Error for vector %li (%3.2e) is greater than epsilon (%3.2e)\n",
+                k, error, epsilon);
+            return false;
+        }
+    }
+    return true;
+}
+
+namespace {
+
+// Smallest hash table that is at most half full with n entries
+long
+table_size_for(long n)
+{
+    long size = 64;
+    while (size < 2 * n) { size *= 2; }
+    return size;
+}
+
+} // end anonymous namespace
+
+ppr_push::ppr_push(graph & g)
+: g_(g)
+, table_(table_size_for(0), entry{-1, 0, 0})
+, queue_head_(0)
+, num_pushes_(0)
+, num_edges_traversed_(0)
+{}
+
+// Returns the slot holding v, or the empty slot where it would go
+long
+ppr_push::slot(long v) const
+{
+    long mask = table_.size() - 1;
+    // Fibonacci hashing, so nearby vertex IDs spread over the table
+    long i = (long)(((unsigned long)v * 0x9E3779B97F4A7C15UL) >> 32) & mask;
+    while (table_[i].vertex != v && table_[i].vertex != -1) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+// Rehashes every entry into a table twice as big
+void
+ppr_push::grow_table()
+{
+    std::vector<entry> old_table(table_.size() * 2, entry{-1, 0, 0});
+    old_table.swap(table_);
+    for (const entry & e : old_table) {
+        if (e.vertex != -1) { table_[slot(e.vertex)] = e; }
+    }
+}
+
+const ppr_push::entry *
+ppr_push::lookup(long v) const
+{
+    const entry & e = table_[slot(v)];
+    return e.vertex == v ? &e : nullptr;
+}
+
+ppr_push::entry &
+ppr_push::insert(long v)
+{
+    long i = slot(v);
+    if (table_[i].vertex == v) { return table_[i]; }
+    if (2 * ((long)touched_.size() + 1) > (long)table_.size()) {
+        grow_table();
+        i = slot(v);
+    }
+    touched_.push_back(v);
+    table_[i] = entry{v, 0, 0};
+    return table_[i];
+}
+
+void
+ppr_push::add_residual(long v, double r, double epsilon)
+{
+    entry & e = insert(v);
+    double old_r = e.residual;
+    e.residual = old_r + r;
+    // Queue the vertex when it crosses the threshold. Residuals only grow
+    // until the vertex is pushed, so it is never in the queue twice.
+    double threshold = epsilon * g_.out_degree(v);
+    if (old_r <= threshold && e.residual > threshold) { queue_.push_back(v); }
+}
+
+void
+ppr_push::run(const std::vector<long> & seeds, double damping, double epsilon)
+{
+    assert(!seeds.empty());
+    // Start from an empty table sized for the last query
+    table_.assign(table_size_for(touched_.size()), entry{-1, 0, 0});
+    touched_.clear();
+    queue_.clear();
+    queue_head_ = 0;
+    num_pushes_ = 0;
+    num_edges_traversed_ = 0;
+    seeds_ = seeds;
+
+    for (long s : seeds) {
+        assert(s < g_.num_vertices());
+        add_residual(s, 1.0 / seeds.size(), epsilon);
+    }
+    while (queue_head_ < (long)queue_.size()) {
+        long u = queue_[queue_head_++];
+        // Adding residuals below can move the table, don't hold on to this
+        entry & pushed = insert(u);
+        double r = pushed.residual;
+        pushed.residual = 0;
+        pushed.estimate += (1.0 - damping) * r;
+        ++num_pushes_;
+        // A vertex with no edges keeps its share, the rest is lost, as in ppr
+        long degree = g_.out_degree(u);
+        if (degree == 0) { continue; }
+        double contrib = damping * r / degree;
+        auto edges_begin = g_.out_neighbors(u);
+        auto edges_end = edges_begin + degree;
+        for (auto e = edges_begin; e < edges_end; ++e) {
+            add_residual(*e, contrib, epsilon);
+        }
+        num_edges_traversed_ += degree;
+    }
+}
+
+std::vector<long>
+ppr_push::top(long n) const
+{
+    std::vector<long> vertices(touched_);
+    n = std::min(n, (long)vertices.size());
+    std::partial_sort(vertices.begin(), vertices.begin() + n, vertices.end(),
+        [this](long a, long b) {
+            double ea = estimate(a);
+            double eb = estimate(b);
+            return ea != eb ? ea > eb : a < b;
+        }
+    );
+    vertices.resize(n);
+    return vertices;
+}
+
+bool
+ppr_push::check(double damping, double epsilon)
+{
+    // Every residual must be under the threshold
+    double residual_sum = 0;
+    for (long v : touched_) {
+        double r = lookup(v)->residual;
+        if (r > epsilon * g_.out_degree(v)) {
+            LOG("Residual of vertex %li (%3.2e) is over the threshold\n", v, r);
+            return false;
+        }
+        residual_sum += r;
+    }
+
+    // Power iteration to (nearly) the exact vector
+    long n = g_.num_vertices();
+    std::vector<double> base(n, 0);
+    for (long s : seeds_) { base[s] += (1.0 - damping) / seeds_.size(); }
+    std::vector<double> scores(base);
+    std::vector<double> incoming(n);
+    double change = 1;
+    for (long iter = 0; iter < 1000 && change > 1e-12; ++iter) {
+        std::fill(incoming.begin(), incoming.end(), 0);
+        for (long u = 0; u < n; ++u) {
+            long degree = g_.out_degree(u);
+            if (degree == 0) { continue; }
+            double contrib = scores[u] / degree;
+            auto edges_begin = g_.out_neighbors(u);
+            auto edges_end = edges_begin + degree;
+            for (auto e = edges_begin; e < edges_end; ++e) {
+                incoming[*e] += contrib;
+            }
+        }
+        change = 0;
+        for (long v = 0; v < n; ++v) {
+            double score = base[v] + damping * incoming[v];
+            change += std::fabs(score - scores[v]);
+            scores[v] = score;
+        }
+    }
+
+    // The residuals left over account for all of the missing score, and
+    // no estimate can be more than the exact score
+    const double tolerance = 1e-9;
+    double missing = 0;
+    for (long v = 0; v < n; ++v) {
+        double e = estimate(v);
+        if (e > scores[v] + tolerance) {
+            LOG("Estimate for vertex %li (%3.2e) is greater than its score (%3.2e)\n",
+                v, e, scores[v]);
+            return false;
+        }
+        missing += scores[v] - e;
+    }
+    if (missing > residual_sum + tolerance) {
+        LOG("Estimates are missing %3.2e, but only %3.2e is left in residuals\n",
+            missing, residual_sum);
+        return false;
+    }
+    return true;
+}
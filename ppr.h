@@ -0,0 +1,177 @@
+#pragma once
+
+#include <vector>
+#include <emu_cxx_utils/replicated.h>
+#include <emu_cxx_utils/repl_array.h>
+#include "common.h"
+#include "graph.h"
+#include "edge_schedule.h"
+
+/**
+ * Batched personalized PageRank
+ *
+ * Computes up to block_size personalization vectors at once. Instead of
+ * restarting at a uniformly random vertex, the walk for vector k restarts at
+ * a random vertex from its seed set. Each vertex stores the values for all
+ * the vectors in one block, so a single visit to an edge updates every
+ * vector, and the inner loop over the block has a fixed length.
+ *
+ * Vectors that have converged keep being updated along with the rest of the
+ * block, their error only gets smaller. The batch stops when every vector
+ * has converged, or after max_iters.
+ */
+class ppr
+{
+public:
+    // Number of vectors computed in a single pass
+    static constexpr long block_size = 8;
+
+    /**
+     * Array of block_size values for each vertex. striped_array can only
+     * hold 64-bit types, so the blocks for the vertices on each nodelet are
+     * packed into a replicated array instead. Like a striped_array, the
+     * block for vertex v lives on nodelet v % NODELETS().
+     */
+    class block_array
+    {
+    private:
+        emu::repl_array<double> data_;
+    public:
+        explicit block_array(long num_vertices)
+        : data_((num_vertices + NODELETS() - 1) / NODELETS() * block_size) {}
+
+        block_array(const block_array& other, emu::shallow_copy shallow)
+        : data_(other.data_, shallow) {}
+
+        double *
+        operator[](long v)
+        {
+            return data_.get_nth(v & (NODELETS() - 1))
+                + v / NODELETS() * block_size;
+        }
+    };
+
+private:
+    emu::repl<graph*> g_;
+    // Score of each vertex in each vector
+    block_array scores_;
+    // Outgoing contribution from each vertex
+    block_array contrib_;
+    // Incoming contribution from other vertices
+    block_array incoming_;
+    // Score that each vertex gets from restarts, (1 - damping) / |seed set|
+    // for the vertices in the seed set, zero elsewhere
+    block_array base_;
+    emu::repl<double> damping_;
+    // Fixed schedule of all the edges, built once
+    edge_schedule schedule_;
+
+    // Seed sets for the last call to run
+    std::vector<std::vector<long>> seed_sets_;
+    // Iteration in which each vector converged, or -1
+    std::vector<long> converged_iter_;
+
+public:
+    explicit ppr(graph & g);
+    ppr(const ppr& other, emu::shallow_copy);
+
+    /**
+     * Computes a personalized PageRank vector for each seed set
+     * @param seed_sets Up to block_size sets of vertices to restart from
+     * @param max_iters Maximum number of iterations to run
+     * @param damping Damping parameter during rank update
+     * @param epsilon A vector has converged once its scores change by less
+     * than this in total over an iteration
+     * @return Number of iterations performed
+     */
+    int run(const std::vector<std::vector<long>> & seed_sets,
+        int max_iters, double damping, double epsilon);
+    bool check(double damping, double epsilon);
+
+    long num_vectors() const { return seed_sets_.size(); }
+    // Iteration where vector k converged, or -1 if it didn't
+    long converged_iter(long k) const { return converged_iter_[k]; }
+    // Score of vertex v in vector k
+    double score(long v, long k) { return scores_[v][k]; }
+
+    /**
+     * Returns the n vertices with the highest scores in vector k, best first
+     */
+    std::vector<long> top(long k, long n);
+};
+
+/**
+ * Local push personalized PageRank (Andersen, Chung and Lang)
+ *
+ * Answers one query at a time, for a single seed or a small seed set, with
+ * work proportional to the part of the graph near the seeds rather than the
+ * whole graph. Each vertex has an estimate and a residual. A vertex whose
+ * residual is more than epsilon times its degree is pushed: it keeps
+ * (1 - damping) of the residual in its estimate and spreads the rest evenly
+ * over its neighbors.
+ *
+ * The estimates and residuals are kept in an open-addressing hash table
+ * keyed by vertex, which grows with the number of vertices the query
+ * touches. Each query starts from a table sized for the previous one, so
+ * memory and setup cost depend on the output, not on the size of the graph.
+ * Queries are serial; run more of them at once by giving each thread its own
+ * ppr_push.
+ */
+class ppr_push
+{
+private:
+    graph & g_;
+    struct entry
+    {
+        long vertex;
+        double estimate;
+        double residual;
+    };
+    // Hash table of touched vertices, linear probing, at most half full.
+    // Size is a power of two, empty slots have a vertex of -1.
+    std::vector<entry> table_;
+    // Vertices in the table, in the order they were touched
+    std::vector<long> touched_;
+    // Vertices waiting to be pushed, processed in order from queue_head_
+    std::vector<long> queue_;
+    long queue_head_;
+    // Seed set for the last query
+    std::vector<long> seeds_;
+    long num_pushes_;
+    long num_edges_traversed_;
+
+    long slot(long v) const;
+    void grow_table();
+    const entry * lookup(long v) const;
+    entry & insert(long v);
+    void add_residual(long v, double r, double epsilon);
+public:
+    explicit ppr_push(graph & g);
+
+    /**
+     * Computes the personalized PageRank vector for a seed set
+     * @param seeds Vertices to restart from
+     * @param damping Damping parameter during rank update
+     * @param epsilon Push vertices while their residual is more than this
+     * times their degree
+     */
+    void run(const std::vector<long> & seeds, double damping, double epsilon);
+    bool check(double damping, double epsilon);
+
+    // Number of vertices with a nonzero estimate or residual
+    long num_touched() const { return touched_.size(); }
+    // Number of slots in the hash table
+    long table_size() const { return table_.size(); }
+    long num_pushes() const { return num_pushes_; }
+    long num_edges_traversed() const { return num_edges_traversed_; }
+    double estimate(long v) const
+    {
+        const entry * e = lookup(v);
+        return e ? e->estimate : 0;
+    }
+
+    /**
+     * Returns the n touched vertices with the highest estimates, best first
+     */
+    std::vector<long> top(long n) const;
+};
@@ -0,0 +1,431 @@
+#include <string.h>
+#include <getopt.h>
+#include <limits.h>
+#include <vector>
+#include <algorithm>
+#include <cilk/cilk.h>
+
+#include "graph.h"
+#include "dist_edge_list.h"
+#include "ppr.h"
+#include "lcg.h"
+#include "git_sha1.h"
+
+const struct option long_options[] = {
+    {"graph_filename"   , required_argument},
+    {"distributed_load" , no_argument},
+    {"num_trials"       , required_argument},
+    {"num_seeds"        , required_argument},
+    {"seed_set_size"    , required_argument},
+    {"max_iterations"   , required_argument},
+    {"epsilon"          , required_argument},
+    {"damping"          , required_argument},
+    {"top_n"            , required_argument},
+    {"algorithm"        , required_argument},
+    {"num_concurrent"   , required_argument},
+    {"dump_edge_list"   , no_argument},
+    {"check_graph"      , no_argument},
+    {"dump_graph"       , no_argument},
+    {"check_results"    , no_argument},
+    {"version"          , no_argument},
+    {"help"             , no_argument},
+    {nullptr}
+};
+
+void
+print_help(const char* argv0)
+{
+    LOG( "Usage: %s [OPTIONS]\n", argv0);
+    LOG("\t--graph_filename     Path to graph file to load\n");
+    LOG("\t--distributed_load   Load the graph from all nodes at once (File must exist on all nodes, use absolute path).\n");
+    LOG("\t--num_trials         Run the algorithm this many times.\n");
+    LOG("\t--num_seeds          Compute this many personalized PageRank vectors, %li at a time.\n", ppr::block_size);
+    LOG("\t--seed_set_size      Number of random vertices in the seed set of each vector.\n");
+    LOG("\t--max_iterations     Maximum number of iterations.\n");
+    LOG("\t--epsilon            Error tolerance; run until aggregate score change is less than epsilon.\n");
+    LOG("\t                     With push, push vertices while their residual is more than epsilon times their degree.\n");
+    LOG("\t--damping            Damping factor for pagerank.\n");
+    LOG("\t--top_n              Print the n vertices with the highest score for each vector.\n");
+    LOG("\t--algorithm          Select personalized PageRank implementation to run\n");
+    LOG("\t                     (batch or push)\n");
+    LOG("\t--num_concurrent     With push, run this many queries at once.\n");
+    LOG("\t--dump_edge_list     Print the edge list to stdout after loading (slow)\n");
+    LOG("\t--check_graph        Validate the constructed graph against the edge list (slow)\n");
+    LOG("\t--dump_graph         Print the graph to stdout after construction (slow)\n");
+    LOG("\t--check_results      Validate the results (slow)\n");
+    LOG("\t--version            Print git version info\n");
+    LOG("\t--help               Print command line help\n");
+}
+
+struct ppr_args
+{
+    const char* graph_filename;
+    bool distributed_load;
+    long num_trials;
+    long num_seeds;
+    long seed_set_size;
+    long max_iterations;
+    double epsilon;
+    double damping;
+    long top_n;
+    const char* algorithm;
+    long num_concurrent;
+    bool dump_edge_list;
+    bool check_graph;
+    bool dump_graph;
+    bool check_results;
+
+    static ppr_args
+    parse(int argc, char *argv[])
+    {
+        ppr_args args = {};
+        args.graph_filename = NULL;
+        args.distributed_load = false;
+        args.num_trials = 1;
+        args.num_seeds = ppr::block_size;
+        args.seed_set_size = 1;
+        args.max_iterations = 100;
+        args.epsilon = 1e-5;
+        args.damping = 0.85;
+        args.top_n = 0;
+        args.algorithm = "batch";
+        args.num_concurrent = ppr::block_size;
+        args.dump_edge_list = false;
+        args.check_graph = false;
+        args.dump_graph = false;
+        args.check_results = false;
+
+        int option_index;
+        while (true) {
+            int c = getopt_long(argc, argv, "", long_options, &option_index);
+            // Done parsing
+            if (c == -1) { break; }
+            // Parse error
+            if (c == '?') {
+                LOG( "Invalid arguments\n");
+                print_help(argv[0]);
+                exit(1);
+            }
+            const char* option_name = long_options[option_index].name;
+
+            if (!strcmp(option_name, "graph_filename")) {
+                args.graph_filename = optarg;
+            } else if (!strcmp(option_name, "distributed_load")) {
+                args.distributed_load = true;
+            } else if (!strcmp(option_name, "num_trials")) {
+                args.num_trials = atol(optarg);
+            } else if (!strcmp(option_name, "num_seeds")) {
+                args.num_seeds = atol(optarg);
+            } else if (!strcmp(option_name, "seed_set_size")) {
+                args.seed_set_size = atol(optarg);
+            } else if (!strcmp(option_name, "max_iterations")) {
+                args.max_iterations = atol(optarg);
+            } else if (!strcmp(option_name, "epsilon")) {
+                args.epsilon = atof(optarg);
+            } else if (!strcmp(option_name, "damping")) {
+                args.damping = atof(optarg);
+            } else if (!strcmp(option_name, "top_n")) {
+                args.top_n = atol(optarg);
+            } else if (!strcmp(option_name, "algorithm")) {
+                args.algorithm = optarg;
+            } else if (!strcmp(option_name, "num_concurrent")) {
+                args.num_concurrent = atol(optarg);
+            } else if (!strcmp(option_name, "dump_edge_list")) {
+                args.dump_edge_list = true;
+            } else if (!strcmp(option_name, "check_graph")) {
+                args.check_graph = true;
+            } else if (!strcmp(option_name, "dump_graph")) {
+                args.dump_graph = true;
+            } else if (!strcmp(option_name, "check_results")) {
+                args.check_results = true;
+            } else if (!strcmp(option_name, "version")) {
+                LOG("%s\n", g_GIT_TAG);
+                exit(0);
+            } else if (!strcmp(option_name, "help")) {
+                print_help(argv[0]);
+                exit(1);
+            }
+        }
+        if (args.graph_filename == NULL) { LOG( "Missing graph filename\n"); exit(1); }
+        if (args.num_trials <= 0) { LOG( "num_trials must be > 0\n"); exit(1); }
+        if (args.num_seeds <= 0) { LOG( "num_seeds must be > 0\n"); exit(1); }
+        if (args.seed_set_size <= 0) { LOG( "seed_set_size must be > 0\n"); exit(1); }
+        if (args.max_iterations <= 0) { LOG( "max_iterations must be > 0\n"); exit(1); }
+        if (args.damping <= 0) { LOG( "damping must be > 0\n"); exit(1); }
+        if (args.epsilon < 0) { LOG( "epsilon must not be negative\n"); exit(1); }
+        if (args.top_n < 0) { LOG( "top_n must be >= 0\n"); exit(1); }
+        if (args.num_concurrent <= 0) { LOG( "num_concurrent must be > 0\n"); exit(1); }
+        return args;
+    }
+};
+
+// Pick a random vertex with positive degree
+long
+pick_random_vertex(graph& g, lcg& rng)
+{
+    long v;
+    do {
+        v = rng() % g.num_vertices();
+    } while (g.out_degree(v) == 0);
+    return v;
+}
+
+std::vector<long>
+pick_seed_set(graph& g, long seed_set_size, lcg& rng)
+{
+    std::vector<long> seeds;
+    for (long i = 0; i < seed_set_size; ++i) {
+        seeds.push_back(pick_random_vertex(g, rng));
+    }
+    return seeds;
+}
+
+/**
+ * Compute all the vectors with the batched algorithm, block_size at a time
+ * Returns false if any check fails
+ */
+bool
+run_batch(graph& g, const ppr_args& args, lcg& rng)
+{
+    bool success = true;
+    LOG("Initializing data structures...\n");
+    auto pr = emu::make_repl_shallow<ppr>(g);
+
+    // Run multiple trials of the algorithm
+    for (long trial = 0; trial < args.num_trials; ++trial) {
+        hooks_set_attr_i64("trial", trial);
+        double time_ms_all_batches = 0;
+        long num_iters_all_batches = 0;
+        for (long first = 0; first < args.num_seeds; first += ppr::block_size) {
+            long num_vectors = std::min(ppr::block_size, args.num_seeds - first);
+            std::vector<std::vector<long>> seed_sets(num_vectors);
+            for (auto & seeds : seed_sets) {
+                seeds = pick_seed_set(g, args.seed_set_size, rng);
+            }
+            hooks_set_attr_i64("first_seed", first);
+
+            LOG("Computing personalized PageRank for seeds %li-%li of %li...\n",
+                first + 1, first + num_vectors, args.num_seeds);
+            hooks_region_begin("ppr");
+            int num_iters = pr->run(seed_sets,
+                args.max_iterations, args.damping, args.epsilon);
+            hooks_set_attr_i64("num_iters", num_iters);
+            double time_ms = hooks_region_end();
+            time_ms_all_batches += time_ms;
+            num_iters_all_batches += num_iters;
+            LOG("Computed %li vectors in %i iterations (%3.2f ms)\n",
+                num_vectors, num_iters, time_ms);
+
+            for (long k = 0; k < num_vectors; ++k) {
+                long seed = first + k;
+                long converged_iter = pr->converged_iter(k);
+                if (converged_iter < 0) {
+                    LOG("Seed set %li did not converge", seed);
+                } else {
+                    LOG("Seed set %li converged in %li iterations",
+                        seed, converged_iter);
+                }
+                if (args.top_n > 0) {
+                    LOG(":");
+                    for (long v : pr->top(k, args.top_n)) {
+                        LOG(" %li (%3.2e)", v, pr->score(v, k));
+                    }
+                }
+                LOG("\n");
+            }
+
+            if (args.check_results) {
+                LOG("Checking results...");
+                if (pr->check(args.damping, args.epsilon)) {
+                    LOG("PASS\n");
+                } else {
+                    LOG("FAIL\n");
+                    success = false;
+                }
+            }
+        }
+        // Each iteration visits every edge once for a whole batch
+        double teps = num_iters_all_batches * g.num_edges() / (1e-3 * time_ms_all_batches);
+        LOG("Computed %li vectors in %3.2f ms, %3.2f MTEPS\n",
+            args.num_seeds, time_ms_all_batches, 1e-6 * teps);
+    }
+    return success;
+}
+
+// Called on the nodelet of the slot, so the engine's memory is allocated there
+void
+make_engine(ppr_push ** slot, graph & g)
+{
+    *slot = new ppr_push(g);
+}
+
+/**
+ * Answer each seed set as a separate local push query, num_concurrent at
+ * a time. Each concurrent query gets its own engine, which is reused for
+ * the queries that follow it. Engines are dealt out round-robin to the
+ * nodelets, and each one is built and runs its queries on its own nodelet.
+ * Returns false if any check fails
+ */
+bool
+run_push(graph& g, const ppr_args& args, lcg& rng)
+{
+    bool success = true;
+    LOG("Initializing data structures...\n");
+    long num_engines = std::min(args.num_concurrent, args.num_seeds);
+    // Pointer to engine k is stored in slot k on nodelet k % NODELETS()
+    emu::repl_array<ppr_push *> slots(num_engines);
+    std::vector<ppr_push *> engines(num_engines);
+    for (long k = 0; k < num_engines; ++k) {
+        ppr_push ** slot = slots.get_nth(k & (NODELETS() - 1)) + k;
+        cilk_spawn_at(slot) make_engine(slot, g);
+    }
+    cilk_sync;
+    for (long k = 0; k < num_engines; ++k) {
+        engines[k] = slots.get_nth(k & (NODELETS() - 1))[k];
+    }
+
+    for (long trial = 0; trial < args.num_trials; ++trial) {
+        hooks_set_attr_i64("trial", trial);
+        double time_ms_all_groups = 0;
+        long num_edges_all_groups = 0;
+        for (long first = 0; first < args.num_seeds; first += num_engines) {
+            long num_queries = std::min(num_engines, args.num_seeds - first);
+            std::vector<std::vector<long>> seed_sets(num_queries);
+            for (auto & seeds : seed_sets) {
+                seeds = pick_seed_set(g, args.seed_set_size, rng);
+            }
+            hooks_set_attr_i64("first_seed", first);
+
+            LOG("Computing personalized PageRank for seeds %li-%li of %li...\n",
+                first + 1, first + num_queries, args.num_seeds);
+            hooks_region_begin("ppr_push");
+            for (long k = 0; k < num_queries; ++k) {
+                ppr_push * engine = engines[k];
+                cilk_spawn_at(engine) engine->run(seed_sets[k], args.damping, args.epsilon);
+            }
+            cilk_sync;
+            double time_ms = hooks_region_end();
+            time_ms_all_groups += time_ms;
+            LOG("Computed %li queries (%3.2f ms)\n", num_queries, time_ms);
+
+            for (long k = 0; k < num_queries; ++k) {
+                const ppr_push & q = *engines[k];
+                long seed = first + k;
+                num_edges_all_groups += q.num_edges_traversed();
+                LOG("Seed set %li: %li pushes, %li edges, %li vertices touched",
+                    seed, q.num_pushes(), q.num_edges_traversed(), q.num_touched());
+                if (args.top_n > 0) {
+                    LOG(", top:");
+                    for (long v : q.top(args.top_n)) {
+                        LOG(" %li (%3.2e)", v, q.estimate(v));
+                    }
+                }
+                LOG("\n");
+            }
+
+            if (args.check_results) {
+                LOG("Checking results...");
+                bool group_success = true;
+                for (long k = 0; k < num_queries; ++k) {
+                    if (!engines[k]->check(args.damping, args.epsilon)) {
+                        group_success = false;
+                    }
+                }
+                if (group_success) {
+                    LOG("PASS\n");
+                } else {
+                    LOG("FAIL\n");
+                    success = false;
+                }
+            }
+        }
+        double teps = num_edges_all_groups / (1e-3 * time_ms_all_groups);
+        LOG("Computed %li queries in %3.2f ms, %li edges traversed, %3.2f MTEPS\n",
+            args.num_seeds, time_ms_all_groups, num_edges_all_groups, 1e-6 * teps);
+    }
+    for (ppr_push * engine : engines) { delete engine; }
+    return success;
+}
+
+int main(int argc, char ** argv)
+{
+    bool success = true;
+    // Set active region for hooks
+    const char* active_region = getenv("HOOKS_ACTIVE_REGION");
+    if (active_region != NULL) {
+        hooks_set_active_region(active_region);
+    } else {
+        hooks_set_active_region("ppr");
+    }
+    hooks_set_attr_str("git_tag", g_GIT_TAG);
+
+    // Initialize RNG with deterministic seed
+    lcg rng(0);
+
+    // Parse command-line arguments
+    ppr_args args = ppr_args::parse(argc, argv);
+
+    // Load edge list from file
+    dist_edge_list::handle dist_el;
+    hooks_region_begin("load_edge_list");
+    if (args.distributed_load) {
+        dist_el = dist_edge_list::load_distributed(args.graph_filename);
+    } else {
+        dist_el = dist_edge_list::load_binary(args.graph_filename);
+    }
+    hooks_set_attr_i64("num_edges", dist_el->num_edges());
+    hooks_set_attr_i64("num_vertices", dist_el->num_vertices());
+    auto load_time_ms = hooks_region_end();
+    LOG("Loaded %li edges in %3.2f ms, %3.2f MB/s\n",
+        dist_el->num_edges(),
+        load_time_ms,
+        (1e-6 * dist_el->num_edges() * sizeof(edge)) / (1e-3 * load_time_ms));
+    if (args.dump_edge_list) {
+        LOG("Dumping edge list...\n");
+        dist_el->dump();
+    }
+
+    // Build the graph
+    LOG("Constructing graph...\n");
+    auto g = create_graph_from_edge_list<graph>(*dist_el);
+
+    g->print_distribution();
+    if (args.check_graph) {
+        LOG("Checking graph...");
+        if (g->check(*dist_el)) {
+            LOG("PASS\n");
+        } else {
+            LOG("FAIL\n");
+            success = false;
+        };
+    }
+    if (args.dump_graph) {
+        LOG("Dumping graph...\n");
+        g->dump();
+    }
+
+    enum ppr_alg {
+        BATCH,
+        PUSH,
+    } alg;
+    if        (!strcmp(args.algorithm, "batch")) {
+        alg = BATCH;
+    } else if (!strcmp(args.algorithm, "push")) {
+        alg = PUSH;
+    } else {
+        LOG("Algorithm '%s' not implemented!\n", args.algorithm);
+        exit(1);
+    }
+    hooks_set_attr_str("algorithm", args.algorithm);
+
+    switch (alg) {
+        case BATCH:
+            if (!run_batch(*g, args, rng)) { success = false; }
+            break;
+        case PUSH:
+            if (!run_push(*g, args, rng)) { success = false; }
+            break;
+    }
+
+    return !success;
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <unistd.h>
+#include <cilk/cilk.h>
+#include <cilk/cilk_api.h>
+#include <emu_cxx_utils/execution_policy.h>
+#include "graph.h"
+
+/**
+ * Propagation blocking, for sums over the neighbors of every vertex on a
+ * cache-based (x86) machine.
+ *
+ * Pulling contrib[dst] for every edge is a random read over the whole vertex
+ * array, which misses in the last level cache once the graph is large
+ * enough. Instead, the contribution along each edge is first written out to
+ * a bin chosen by the destination vertex, streaming through each bin. Then
+ * the bins are summed in parallel, each worker summing one bin at a time.
+ * Each bin only writes to a range of vertices, small enough that the ranges
+ * for all the workers fit in the shared cache together.
+ *
+ * The destination of every entry only depends on the graph, so it is binned
+ * once when this is built. Each call to bin only writes the values.
+ * This needs 16 bytes per edge on top of the graph.
+ */
+class propagation_bins
+{
+private:
+    using edge_iterator = graph::edge_iterator;
+
+    graph & g_;
+    // Vertices in each bin, as a power of two
+    long bin_shift_;
+    long num_bins_;
+    // Source vertices are split into chunks, each filled by one thread
+    long num_chunks_;
+    // Start of the entries from each chunk in each bin, bin-major, so that
+    // all the entries in a bin are contiguous. Has one extra at the end.
+    std::vector<long> offsets_;
+    // Destination vertex and value of each entry
+    std::vector<long> dst_;
+    std::vector<double> val_;
+
+    long chunk_begin(long c) const { return g_.num_vertices() * c / num_chunks_; }
+
+    long offset(long b, long c) const { return offsets_[b * num_chunks_ + c]; }
+
+    template<class Value>
+    void
+    bin_chunk(long c, Value value)
+    {
+        // Each chunk has its own range of each bin, no atomics needed
+        std::vector<long> pos(num_bins_);
+        for (long b = 0; b < num_bins_; ++b) { pos[b] = offset(b, c); }
+        for (long src = chunk_begin(c); src < chunk_begin(c + 1); ++src) {
+            double v = value(src);
+            edge_iterator e1 = g_.out_edges_begin(src);
+            edge_iterator e2 = g_.out_edges_end(src);
+            for (edge_iterator e = e1; e < e2; ++e) {
+                val_[pos[*e >> bin_shift_]++] = v;
+            }
+        }
+    }
+
+    void
+    accumulate_bin(long b, double * sums)
+    {
+        long end = offsets_[(b + 1) * num_chunks_];
+        for (long i = offset(b, 0); i < end; ++i) { sums[dst_[i]] += val_[i]; }
+    }
+
+public:
+    /**
+     * @param g Graph to bin. Edges must not be added or removed after
+     * this is built.
+     * @param bin_width Max number of vertices in each bin, rounded down to
+     * a power of two. Bins are made smaller if needed so that every worker
+     * has a bin to sum.
+     */
+    propagation_bins(graph & g, long bin_width)
+    : g_(g)
+    , bin_shift_(0)
+    , num_chunks_(emu::threads_per_nodelet)
+    {
+        while ((2L << bin_shift_) <= bin_width) { ++bin_shift_; }
+        long num_workers = __cilkrts_get_nworkers();
+        while (bin_shift_ > 0
+            && ((g.num_vertices() - 1) >> bin_shift_) + 1 < num_workers) {
+            --bin_shift_;
+        }
+        num_bins_ = ((g.num_vertices() - 1) >> bin_shift_) + 1;
+
+        // Count the entries from each chunk in each bin
+        offsets_.assign(num_bins_ * num_chunks_ + 1, 0);
+        for (long c = 0; c < num_chunks_; ++c) {
+            for (long src = chunk_begin(c); src < chunk_begin(c + 1); ++src) {
+                edge_iterator e2 = g.out_edges_end(src);
+                for (edge_iterator e = g.out_edges_begin(src); e < e2; ++e) {
+                    offsets_[(*e >> bin_shift_) * num_chunks_ + c] += 1;
+                }
+            }
+        }
+        long total = 0;
+        for (long & count : offsets_) {
+            long n = count;
+            count = total;
+            total += n;
+        }
+        dst_.resize(total);
+        val_.resize(total);
+
+        // Fill in the destinations, in the same order bin will use
+        for (long c = 0; c < num_chunks_; ++c) {
+            std::vector<long> pos(num_bins_);
+            for (long b = 0; b < num_bins_; ++b) { pos[b] = offset(b, c); }
+            for (long src = chunk_begin(c); src < chunk_begin(c + 1); ++src) {
+                edge_iterator e2 = g.out_edges_end(src);
+                for (edge_iterator e = g.out_edges_begin(src); e < e2; ++e) {
+                    dst_[pos[*e >> bin_shift_]++] = *e;
+                }
+            }
+        }
+    }
+
+    /**
+     * Picks a bin width so the sums for the bins being summed by all the
+     * workers at once take up half of the last level cache, leaving the rest
+     * for streaming through the bins.
+     * @param cache_bytes Size of the cache, or zero to ask the OS
+     */
+    static long
+    bin_width_for_cache(long cache_bytes)
+    {
+        if (cache_bytes <= 0) { cache_bytes = sysconf(_SC_LEVEL3_CACHE_SIZE); }
+        if (cache_bytes <= 0) { cache_bytes = sysconf(_SC_LEVEL2_CACHE_SIZE); }
+        // Assume a small cache if the OS doesn't know
+        if (cache_bytes <= 0) { cache_bytes = 1L << 20; }
+        long num_workers = __cilkrts_get_nworkers();
+        return std::max(1L, cache_bytes / (2 * (long)sizeof(double) * num_workers));
+    }
+
+    long num_bins() const { return num_bins_; }
+    long bin_width() const { return 1L << bin_shift_; }
+
+    /**
+     * Phase 1: write the value of each vertex to the bins of its neighbors
+     * @param value Lambda function returning the value to send along each
+     * edge of a vertex, with signature: @c double (long src)
+     */
+    template<class Value>
+    void
+    bin(Value value)
+    {
+        for (long c = 0; c < num_chunks_; ++c) {
+            cilk_spawn bin_chunk(c, value);
+        }
+        cilk_sync;
+    }
+
+    /**
+     * Phase 2: add the values in every bin to the sums for each vertex.
+     * Bins cover disjoint ranges of vertices, no atomics needed. The
+     * runtime gives each worker one bin at a time.
+     */
+    void
+    accumulate(double * sums)
+    {
+        for (long b = 0; b < num_bins_; ++b) {
+            cilk_spawn accumulate_bin(b, sums);
+        }
+        cilk_sync;
+    }
+};
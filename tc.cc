@@ -11,7 +11,8 @@ using namespace emu::parallel;
 
 triangle_count::triangle_count(graph & g)
 : g_(&g)
-, worklist_(g.num_vertices())
+// Split vertices with more than 4K edges across nodelets
+, worklist_(g.num_vertices(), g.num_edges() * 2, 4096)
 {
     clear();
 }
@@ -34,13 +35,14 @@ triangle_count::stats
 triangle_count::run()
 {
     worklist_.clear_all();
-    g_->for_each_vertex(fixed, [this](long u) {
+    g_->for_each_vertex(fixed,
+        [this, append=worklist_.make_appender()](long u) mutable {
         // Use binary search to find neighbors of u that are less than u.
         auto v_begin = g_->out_edges_begin(u);
         auto v_end = std::lower_bound(v_begin, g_->out_edges_end(u), u);
         // Add these edges to the work list
         if (v_begin != v_end) {
-            worklist_.append(u, v_begin, v_end);
+            append(u, v_begin, v_end);
         }
     });
 
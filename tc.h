@@ -1,6 +1,6 @@
 #include <emu_cxx_utils/replicated.h>
 #include "graph.h"
-#include "worklist.h"
+#include "array_worklist.h"
 
 class triangle_count
 {
@@ -11,7 +11,7 @@ private:
     // Reduction variable for number of two-paths in the graph
     emu::repl<long> num_twopaths_;
     // Work list of edges to process
-    worklist<graph::edge_type> worklist_;
+    array_worklist<graph::edge_type> worklist_;
 
 public:
     explicit triangle_count(graph& g);
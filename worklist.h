@@ -1,9 +1,18 @@
 #pragma once
 #include <emu_cxx_utils/replicated.h>
+#include <emu_cxx_utils/repl_array.h>
 #include <emu_cxx_utils/intrinsics.h>
 #include <emu_cxx_utils/execution_policy.h>
 #include <cilk/cilk.h>
 
+/**
+ * Execution policy for worklist::process_all_ranges
+ * Same as dynamic_policy, but once a worker runs out of work on its own
+ * nodelet, it will steal grain-sized ranges from the other nodelets' lists.
+ */
+template<long Grain>
+struct stealing_policy : public emu::dynamic_policy<Grain> {};
+
 template<class Edge>
 class worklist {
 private:
@@ -22,19 +31,88 @@ private:
     // Pointer past the end of edge list to process
     emu::striped_array<Edge*> edges_end_;
 
+    // Set when a worker reaches the end of this nodelet's list. At that
+    // point every edge has been claimed, so thieves can skip this nodelet.
+    volatile long drained_;
+    // Number of ranges/edges that workers from this nodelet stole from
+    // other nodelets since the last clear()
+    long num_steals_;
+    long num_edges_stolen_;
+
+    // Vertices with more than this many edges are split into several
+    // independent items when appended. Zero disables splitting.
+    long split_threshold_;
+    // Number of split items in the local array
+    long num_split_;
+    // Index of the next split item to be claimed by a worker
+    long next_split_;
+    // Storage for split items on each nodelet
+    emu::repl_array<long> split_src_;
+    emu::repl_array<Edge*> split_begin_;
+    emu::repl_array<Edge*> split_end_;
+    // Pointers to the copy of each array that is local to this nodelet
+    long * split_src_ptr_;
+    Edge ** split_begin_ptr_;
+    Edge ** split_end_ptr_;
+
+    // Max number of split items on each nodelet. Every item except the last
+    // one for each vertex holds split_threshold edges, and a split vertex has
+    // more than that, so a vertex with d edges yields at most 2d/threshold.
+    static long
+    split_capacity(long num_edges, long split_threshold)
+    {
+        if (split_threshold <= 0) { return 1; }
+        return 2 * num_edges / split_threshold + 1;
+    }
+
 public:
 
     explicit worklist(long num_vertices)
+    : worklist(num_vertices, 0, 0)
+    {}
+
+    /**
+     * Constructs a work list that splits high-degree vertices.
+     * @param num_vertices Number of vertices in the graph
+     * @param num_edges Max number of edges appended between calls to clear()
+     * @param split_threshold Vertices with more edges than this are split
+     * into several items of split_threshold edges, spread across nodelets.
+     */
+    worklist(long num_vertices, long num_edges, long split_threshold)
     : head_(-1)
     , next_vertex_(num_vertices)
     , edges_begin_(num_vertices)
     , edges_end_(num_vertices)
+    , drained_(0)
+    , num_steals_(0)
+    , num_edges_stolen_(0)
+    , split_threshold_(split_threshold)
+    , num_split_(0)
+    , next_split_(0)
+    , split_src_(split_capacity(num_edges, split_threshold))
+    , split_begin_(split_capacity(num_edges, split_threshold))
+    , split_end_(split_capacity(num_edges, split_threshold))
+    , split_src_ptr_(split_src_.get_localto(this))
+    , split_begin_ptr_(split_begin_.get_localto(this))
+    , split_end_ptr_(split_end_.get_localto(this))
     {}
 
     worklist(const worklist& other, emu::shallow_copy shallow)
     : next_vertex_(other.next_vertex_, shallow)
     , edges_begin_(other.edges_begin_, shallow)
     , edges_end_(other.edges_end_, shallow)
+    , drained_(0)
+    , num_steals_(0)
+    , num_edges_stolen_(0)
+    , split_threshold_(other.split_threshold_)
+    , num_split_(0)
+    , next_split_(0)
+    , split_src_(other.split_src_, shallow)
+    , split_begin_(other.split_begin_, shallow)
+    , split_end_(other.split_end_, shallow)
+    , split_src_ptr_(split_src_.get_localto(this))
+    , split_begin_ptr_(split_begin_.get_localto(this))
+    , split_end_ptr_(split_end_.get_localto(this))
     {}
 
     /**
@@ -55,6 +133,11 @@ public:
     void clear()
     {
         head_ = -1;
+        drained_ = 0;
+        num_steals_ = 0;
+        num_edges_stolen_ = 0;
+        num_split_ = 0;
+        next_split_ = 0;
     }
 
     /**
@@ -79,24 +162,161 @@ public:
     void append(long src, Edge * edges_begin, Edge * edges_end)
     {
         assert(emu::pmanip::is_repl(this));
-        // Get the pointer from the nodelet where src vertex lives
-        volatile long * head_ptr = &get_nth(src & (NODELETS()-1)).head_;
-        // Append to head of worklist
+        if (should_split(edges_begin, edges_end)) {
+            append_split(src, edges_begin, edges_end);
+            return;
+        }
         edges_begin_[src] = edges_begin;
         edges_end_[src] = edges_end;
+        // Append to head of the worklist on the nodelet where src lives
+        splice(src & (NODELETS()-1), src, src);
+    }
+
+    /**
+     * Thread-private chain of vertices to be appended to the work list.
+     *
+     * Like the reducers in reducers.h, an appender is meant to be captured by
+     * value in a mutable lambda, so each thread gets its own copy. Each copy
+     * links vertices together without any atomics, then splices the whole
+     * chain onto the work list with a single CAS when it goes out of scope.
+     * This avoids hammering the head pointer with a CAS for every vertex.
+     *
+     * A chain can only hold vertices from one nodelet. If a vertex from a
+     * different nodelet is appended, the current chain is spliced early.
+     * High-degree vertices bypass the chain and are split immediately.
+     */
+    class appender
+    {
+    private:
+        worklist * w_;
+        // First and last vertex in the private chain
+        long head_;
+        long tail_;
+        // Nodelet that owns all the vertices in the chain
+        long nlet_;
+    public:
+        explicit appender(worklist * w)
+        : w_(w), head_(-1), tail_(-1), nlet_(-1) {}
+
+        // Copy constructor: refer to the same worklist, but start a new chain
+        appender(const appender& other) : appender(other.w_) {}
+
+        // Destructor: splice chain into the worklist
+        ~appender() { flush(); }
+
+        /**
+         * Append edges to the private chain
+         *
+         * @param src source vertex for all edges
+         * @param edges_begin Pointer to start of edge list to append
+         * @param edges_end Pointer past the end of the edge list to append
+         */
+        void operator()(long src, Edge * edges_begin, Edge * edges_end)
+        {
+            if (w_->should_split(edges_begin, edges_end)) {
+                w_->append_split(src, edges_begin, edges_end);
+                return;
+            }
+            long nlet = src & (NODELETS()-1);
+            if (nlet != nlet_) {
+                flush();
+                nlet_ = nlet;
+            }
+            w_->edges_begin_[src] = edges_begin;
+            w_->edges_end_[src] = edges_end;
+            // Push onto the front of the private chain
+            w_->next_vertex_[src] = head_;
+            head_ = src;
+            if (tail_ < 0) { tail_ = src; }
+        }
+
+        // Splice the private chain into the worklist
+        void flush()
+        {
+            if (head_ < 0) { return; }
+            w_->splice(nlet_, head_, tail_);
+            head_ = -1;
+            tail_ = -1;
+        }
+    };
+
+    /**
+     * Returns an appender that can be used to add edges to this work list
+     * without contending on the head pointer.
+     * Only valid to call on a replicated instance
+     */
+    appender
+    make_appender()
+    {
+        assert(emu::pmanip::is_repl(this));
+        return appender(this);
+    }
+
+private:
+    bool should_split(Edge * edges_begin, Edge * edges_end) const
+    {
+        return split_threshold_ > 0
+            && edges_end - edges_begin > split_threshold_;
+    }
+
+    // Break the edge list of src into items of split_threshold_ edges, and
+    // deal them out to the split arrays on each nodelet, starting with the
+    // one where src lives. Workers on every nodelet can then claim pieces of
+    // the vertex without contending on a single edges_begin_ pointer.
+    void append_split(long src, Edge * edges_begin, Edge * edges_end)
+    {
+        long nlet = src & (NODELETS()-1);
+        for (Edge * e1 = edges_begin; e1 < edges_end; e1 += split_threshold_) {
+            Edge * e2 = e1 + split_threshold_;
+            if (e2 > edges_end) { e2 = edges_end; }
+            worklist & w = get_nth(nlet);
+            long pos = emu::atomic_addms(&w.num_split_, 1);
+            assert(pos < w.split_src_.size());
+            w.split_src_ptr_[pos] = src;
+            w.split_begin_ptr_[pos] = e1;
+            w.split_end_ptr_[pos] = e2;
+            nlet = (nlet + 1) & (NODELETS()-1);
+        }
+    }
+
+    // Atomically link the chain head->...->tail onto the front of the list
+    // on the specified nodelet
+    void splice(long nlet, long head, long tail)
+    {
+        volatile long * head_ptr = &get_nth(nlet).head_;
         long prev_head;
         do {
             prev_head = *head_ptr;
-            next_vertex_[src] = prev_head;
-        } while (prev_head != emu::atomic_cas(head_ptr, prev_head, src));
+            next_vertex_[tail] = prev_head;
+        } while (prev_head != emu::atomic_cas(head_ptr, prev_head, head));
     }
 
-private:
+    // Number of ranges and edges claimed by a worker
+    struct work_count {
+        long ranges;
+        long edges;
+    };
+
     // Worker function spawned in dynamic process_all
     template<class Visitor, long Grain>
-    void worker(Visitor visitor)
+    work_count worker(Visitor visitor)
     {
         long grain = Grain;
+        work_count count = {0, 0};
+        // Claim whole split items, they are already small enough
+        for (long i = emu::atomic_addms(&next_split_, 1);
+             i < num_split_;
+             i = emu::atomic_addms(&next_split_, 1))
+        {
+            long src = split_src_ptr_[i];
+            auto edges_end = split_end_ptr_[i];
+            for (Edge * e1 = split_begin_ptr_[i]; e1 < edges_end; e1 += grain) {
+                Edge * e2 = e1 + grain; if (e2 > edges_end) { e2 = edges_end; }
+                visitor(src, e1, e2);
+                count.ranges += 1;
+                count.edges += e2 - e1;
+            }
+        }
         // Walk through the worklist
         for (long src = head_; src >= 0; src = next_vertex_[src]) {
             // Get end pointer for the vertex list of src
@@ -111,9 +331,39 @@ private:
                 e2 = e1 + grain; if (e2 > edges_end) { e2 = edges_end; }
                 // Call visitor on the range of edges
                 visitor(src, e1, e2);
+                count.ranges += 1;
+                count.edges += e2 - e1;
             }
             // This vertex is done, move to the next one
         }
+        // Everything in this list has been claimed
+        drained_ = 1;
+        return count;
+    }
+
+    // Worker function spawned in process_all_ranges with stealing_policy
+    template<class Visitor, long Grain>
+    void stealing_worker(worklist * repl_this, long nlet, Visitor visitor)
+    {
+        // Process the local list first
+        worker<Visitor, Grain>(visitor);
+        // Then try to steal from the other nodelets, nearest first. Nodelet
+        // IDs are hierarchical (nodelet within node, node within chassis),
+        // so XOR-ing with an increasing offset visits the other nodelets on
+        // the same node before going off-node.
+        work_count stolen = {0, 0};
+        for (long k = 1; k < NODELETS(); ++k) {
+            worklist & victim = repl_this->get_nth(nlet ^ k);
+            if (victim.drained_) { continue; }
+            auto count = victim.template worker<Visitor, Grain>(visitor);
+            stolen.ranges += count.ranges;
+            stolen.edges += count.edges;
+        }
+        if (stolen.ranges > 0) {
+            worklist & self = repl_this->get_nth(nlet);
+            emu::remote_add(&self.num_steals_, stolen.ranges);
+            emu::remote_add(&self.num_edges_stolen_, stolen.edges);
+        }
     }
 
 public:
@@ -136,8 +386,17 @@ public:
     template<class Visitor, long Grain>
     void process(emu::parallel_policy<Grain> policy, Visitor visitor)
     {
-        // Walk through the worklist
         constexpr long grain = Grain;
+        // Spawn a thread for each granule of the split items
+        for (long i = 0; i < num_split_; ++i) {
+            long src = split_src_ptr_[i];
+            auto end = split_end_ptr_[i];
+            for (auto e1 = split_begin_ptr_[i]; e1 < end; e1 += grain) {
+                auto e2 = e1 + grain; if (e2 > end) { e2 = end; }
+                cilk_spawn visitor(src, e1, e2);
+            }
+        }
+        // Walk through the worklist
         for (long src = head_; src >= 0; src = next_vertex_[src]) {
             // Spawn a thread for each granule
             auto begin = edges_begin_[src];
@@ -159,6 +418,9 @@ public:
     template<class Visitor>
     void process(emu::sequenced_policy, Visitor visitor)
     {
+        for (long i = 0; i < num_split_; ++i) {
+            visitor(split_src_ptr_[i], split_begin_ptr_[i], split_end_ptr_[i]);
+        }
         // Walk through the worklist
         for (long src = head_; src >= 0; src = next_vertex_[src]) {
             // Visit each edge for this vertex
@@ -186,11 +448,63 @@ public:
         );
     }
 
+    /**
+     * Process the edges in all replicated copies of the worklist, with
+     * cross-nodelet work stealing.
+     * Spawns local worker threads on each nodelet to pull items off of
+     * the local work list. Idle workers will then claim ranges from the work
+     * lists on other nodelets, using the same atomic protocol.
+     * Only valid to call on a replicated instance
+     * @param policy Stealing policy: grain size indicates how many items each
+     * thread will pull off the worklist at a time.
+     * @param visitor Lambda function to call on each range of edges, with
+     * signature: @c void (long src, Edge * begin, Edge * end)
+     */
+    template<class Visitor, long Grain>
+    void process_all_ranges(stealing_policy<Grain> policy, Visitor visitor)
+    {
+        assert(emu::pmanip::is_repl(this));
+        worklist * repl_this = this;
+        emu::repl_for_each(emu::parallel_policy<1>(), *this,
+            [repl_this, visitor](worklist & w) {
+                long nlet = emu::pmanip::get_nodelet(&w);
+                for (long t = 0; t < emu::threads_per_nodelet; ++t) {
+                    cilk_spawn w.stealing_worker<Visitor, Grain>(
+                        repl_this, nlet, visitor);
+                }
+            }
+        );
+    }
+
+    struct steal_stats {
+        // Number of ranges claimed from another nodelet's list
+        long num_steals;
+        // Number of edges in those ranges
+        long num_edges_stolen;
+    };
+
+    /**
+     * Returns the total amount of work stolen across all nodelets since the
+     * last call to clear_all()
+     * Only valid to call on a replicated instance
+     */
+    steal_stats
+    get_steal_stats()
+    {
+        assert(emu::pmanip::is_repl(this));
+        steal_stats s = {0, 0};
+        for (long nlet = 0; nlet < NODELETS(); ++nlet) {
+            s.num_steals += get_nth(nlet).num_steals_;
+            s.num_edges_stolen += get_nth(nlet).num_edges_stolen_;
+        }
+        return s;
+    }
+
     template<class Policy, class Visitor>
     void process_all_edges(Policy policy, Visitor visitor)
     {
         process_all_ranges(policy,
-            [visitor](long src, Edge * begin, Edge * end) {
+            [visitor](long src, Edge * begin, Edge * end) mutable {
                 for (auto e = begin; e != end; ++e) {
                     visitor(src, *e);
                 }